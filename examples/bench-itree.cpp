@@ -0,0 +1,690 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <boost/program_options.hpp>
+#include <boost/intrusive/itree.hpp>
+#include <boost/intrusive/btree_itree.hpp>
+#include <boost/intrusive/itree_parallel.hpp>
+#include <boost/intrusive/mapped_itree.hpp>
+#include <boost/intrusive/itree_cursor.hpp>
+#include <boost/intrusive/compact_itree.hpp>
+#include <boost/intrusive/pooled_itree.hpp>
+#include <boost/intrusive/persistent_itree.hpp>
+
+using namespace std;
+namespace bi = boost::intrusive;
+namespace bo = boost::program_options;
+
+struct Value
+{
+    typedef Value* ptr_type;
+
+    size_t _start;
+    size_t _end;
+
+    ptr_type _parent;
+    ptr_type _l_child;
+    ptr_type _r_child;
+    int _col;
+    size_t _max_end;
+};
+
+template <class T>
+struct ITree_Node_Traits
+{
+    typedef T node;
+    typedef node* node_ptr;
+    typedef const node* const_node_ptr;
+    typedef int color;
+    typedef size_t key_type;
+
+    static node_ptr get_parent(const_node_ptr n) { return n->_parent; }
+    static void set_parent(node_ptr n, node_ptr ptr) { n->_parent = ptr; }
+    static node_ptr get_left(const_node_ptr n) { return n->_l_child; }
+    static void set_left(node_ptr n, node_ptr ptr) { n->_l_child = ptr; }
+    static node_ptr get_right(const_node_ptr n) { return n->_r_child; }
+    static void set_right(node_ptr n, node_ptr ptr) { n->_r_child = ptr; }
+    static color get_color(const_node_ptr n) { return n->_col; }
+    static void set_color(node_ptr n, color c) { n->_col = c ; }
+    static color black() { return 0; }
+    static color red() { return 1; }
+    static key_type get_max_end(const_node_ptr n) { return n->_max_end; }
+    static void set_max_end(node_ptr n, key_type k) { n->_max_end = k ; }
+};
+
+template <class T>
+struct ITree_Value_Traits
+{
+    typedef T value_type;
+    typedef ITree_Node_Traits< T > node_traits;
+    typedef typename node_traits::key_type key_type;
+    typedef typename node_traits::node_ptr node_ptr;
+    typedef typename node_traits::const_node_ptr const_node_ptr;
+    typedef node_ptr pointer;
+    typedef const_node_ptr const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    static const bi::link_mode_type link_mode = bi::normal_link;
+
+    static node_ptr to_node_ptr (reference value) { return &value; }
+    static const_node_ptr to_node_ptr (const_reference value) { return &value; }
+    static pointer to_value_ptr(node_ptr n) { return n; }
+    static const_pointer to_value_ptr(const_node_ptr n) { return n; }
+    static key_type get_start(const_pointer n) { return n->_start; }
+    static key_type get_end(const_pointer n) { return n->_end; }
+};
+
+typedef bi::itree< Value, bi::value_traits< ITree_Value_Traits< Value > > > itree_type;
+typedef bi::btree_itree< ITree_Value_Traits< Value > > btree_itree_type;
+typedef multiset< pair< size_t, size_t > > multiset_type;
+
+// nodes with 32-bit links and max_end, in an arena
+struct Compact_Value : public bi::compact_itree_node< uint32_t >
+{
+    size_t _start;
+    size_t _end;
+};
+typedef bi::compact_itree_value_traits< Compact_Value, size_t, &Compact_Value::_start, &Compact_Value::_end,
+                                        uint32_t > compact_value_traits;
+typedef bi::compact_itree< bi::itree< Compact_Value, bi::value_traits< compact_value_traits > > > compact_itree_type;
+
+template < class T >
+struct new_cloner
+{
+    T* operator () (const T& t)
+    {
+        return new T(t);
+    }
+};
+
+template < class T >
+struct delete_disposer
+{
+    void operator () (T* p)
+    {
+        delete p;
+    }
+};
+
+struct Program_Options
+{
+    vector< size_t > sizes;
+    vector< string > dists;
+    size_t n_ops;
+    size_t n_queries;
+    size_t n_naive_queries;
+    size_t naive_max;
+    size_t range_max;
+    size_t max_len;
+    size_t n_threads;
+    size_t parallel_max_results;
+    string mapped_file;
+    size_t seed;
+};
+
+/** Latencies of individual operations, in ns. */
+class Sample
+{
+public:
+    template < class Function >
+    void time(Function&& f)
+    {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration< double, nano > elapsed = chrono::steady_clock::now() - start;
+        _ns.push_back(elapsed.count());
+    }
+
+    double percentile(double p)
+    {
+        if (_ns.empty())
+        {
+            return 0;
+        }
+        size_t k = min(_ns.size() - 1, size_t(p * _ns.size()));
+        nth_element(_ns.begin(), _ns.begin() + k, _ns.end());
+        return _ns[k];
+    }
+
+    double mean() const
+    {
+        double sum = 0;
+        for (auto x : _ns)
+        {
+            sum += x;
+        }
+        return _ns.empty() ? 0 : sum / _ns.size();
+    }
+
+    size_t size() const { return _ns.size(); }
+
+private:
+    vector< double > _ns;
+};
+
+// output: one tab-separated line per (op, distribution, size)
+void print_header()
+{
+    cout << "op\tdist\tsize\tn\tmean_ns\tp50_ns\tp90_ns\tp99_ns\tresults\n";
+}
+
+void print_line(const string& op, const string& dist, size_t size, Sample& s, size_t results)
+{
+    double mean = s.mean();
+    double p50 = s.percentile(.5);
+    double p90 = s.percentile(.9);
+    double p99 = s.percentile(.99);
+    cout << op << '\t' << dist << '\t' << size << '\t' << s.size() << '\t'
+         << mean << '\t' << p50 << '\t' << p90 << '\t' << p99 << '\t' << results << '\n';
+}
+
+/** Draw an interval from a given distribution.
+ * uniform: start and length uniform in [0, range_max) and [0, max_len).
+ * heavy: Pareto distributed lengths, with scale max_len / 10 and shape 1.2.
+ * nested: every interval contains the middle of the range.
+ * long: like uniform, but 10% of lengths are uniform in [0, range_max / 10).
+ */
+void draw_interval(const string& dist, const Program_Options& po, Value& v)
+{
+    size_t len;
+    if (dist == "heavy")
+    {
+        len = size_t(po.max_len / 10.0 * (pow(1.0 - drand48(), -1.0 / 1.2) - 1.0));
+        len = min(len, po.range_max);
+    }
+    else if (dist == "nested")
+    {
+        size_t half = size_t(drand48() * po.range_max / 2);
+        v._start = po.range_max / 2 - half;
+        v._end = po.range_max / 2 + half;
+        return;
+    }
+    else if (dist == "long" and drand48() < .1)
+    {
+        len = size_t(drand48() * po.range_max / 10);
+    }
+    else
+    {
+        len = size_t(drand48() * po.max_len);
+    }
+    v._start = size_t(drand48() * po.range_max);
+    v._end = v._start + len;
+}
+
+template < class Index >
+size_t time_visitor_queries(const string& op, const string& dist, size_t size, Index& index,
+                          const vector< pair< size_t, size_t > >& queries)
+{
+    Sample s;
+    size_t n_results = 0;
+    for (const auto& q : queries)
+    {
+        s.time([&] () {
+            index.for_each_intersection(q.first, q.second, [&] (const Value&) { ++n_results; return true; });
+        });
+    }
+    print_line(op, dist, size, s, n_results);
+    return n_results;
+}
+
+void run(const string& dist, size_t size, const Program_Options& po)
+{
+    vector< Value > v(size);
+    vector< Value > extra(po.n_ops);
+    for (auto& e : v)
+    {
+        draw_interval(dist, po, e);
+    }
+    for (auto& e : extra)
+    {
+        draw_interval(dist, po, e);
+    }
+    vector< pair< size_t, size_t > > queries(po.n_queries);
+    for (auto& q : queries)
+    {
+        q.first = size_t(drand48() * po.range_max);
+        q.second = q.first + size_t(drand48() * po.max_len);
+    }
+    size_t n_results;
+
+    // updates
+    itree_type t(v.begin(), v.end());
+    Sample s_insert;
+    for (auto& e : extra)
+    {
+        s_insert.time([&] () { t.insert(e); });
+    }
+    print_line("insert", dist, size, s_insert, t.size());
+    Sample s_erase;
+    for (auto& e : extra)
+    {
+        s_erase.time([&] () { t.erase(t.iterator_to(e)); });
+    }
+    print_line("erase", dist, size, s_erase, t.size());
+    multiset_type ms;
+    for (const auto& e : v)
+    {
+        ms.insert(make_pair(e._start, e._end));
+    }
+    vector< multiset_type::iterator > ms_its;
+    Sample s_ms_insert;
+    for (const auto& e : extra)
+    {
+        s_ms_insert.time([&] () { ms_its.push_back(ms.insert(make_pair(e._start, e._end))); });
+    }
+    print_line("multiset_insert", dist, size, s_ms_insert, ms.size());
+    Sample s_ms_erase;
+    for (auto it : ms_its)
+    {
+        s_ms_erase.time([&] () { ms.erase(it); });
+    }
+    print_line("multiset_erase", dist, size, s_ms_erase, ms.size());
+
+    // queries
+    Sample s_iintersect;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_iintersect.time([&] () {
+            for (const auto& r : t.iintersect(q.first, q.second))
+            {
+                (void)r;
+                ++n_results;
+            }
+        });
+    }
+    print_line("iintersect", dist, size, s_iintersect, n_results);
+    Sample s_stab;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_stab.time([&] () {
+            for (const auto& r : t.istab(q.first))
+            {
+                (void)r;
+                ++n_results;
+            }
+        });
+    }
+    print_line("istab", dist, size, s_stab, n_results);
+    // containment, with dedicated pruning and by filtering intersections
+    Sample s_containing;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_containing.time([&] () { n_results += size_t(boost::distance(t.icontaining(q.first, q.second))); });
+    }
+    print_line("icontaining", dist, size, s_containing, n_results);
+    Sample s_containing_filter;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_containing_filter.time([&] () {
+            for (const auto& r : t.iintersect(q.first, q.second))
+            {
+                n_results += (r._start <= q.first and q.second <= r._end);
+            }
+        });
+    }
+    print_line("iintersect_filter_containing", dist, size, s_containing_filter, n_results);
+    Sample s_contained_in;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_contained_in.time([&] () { n_results += size_t(boost::distance(t.icontained_in(q.first, q.second))); });
+    }
+    print_line("icontained_in", dist, size, s_contained_in, n_results);
+    Sample s_contained_in_filter;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_contained_in_filter.time([&] () {
+            for (const auto& r : t.iintersect(q.first, q.second))
+            {
+                n_results += (q.first <= r._start and r._end <= q.second);
+            }
+        });
+    }
+    print_line("iintersect_filter_contained_in", dist, size, s_contained_in_filter, n_results);
+    time_visitor_queries("for_each_intersection", dist, size, t, queries);
+    // unsorted batch, one query after the other or interleaved; a single
+    // sample for the whole batch, reported per query
+    for (size_t group_size : { size_t(0), size_t(8), size_t(16) })
+    {
+        n_results = 0;
+        auto start = chrono::steady_clock::now();
+        if (group_size == 0)
+        {
+            for (const auto& q : queries)
+            {
+                for (const auto& r : t.iintersect(q.first, q.second))
+                {
+                    (void)r;
+                    ++n_results;
+                }
+            }
+        }
+        else
+        {
+            t.iintersect_interleaved(queries.begin(), queries.end(),
+                                     [&] (size_t, const Value&) { ++n_results; }, group_size);
+        }
+        chrono::duration< double, nano > elapsed = chrono::steady_clock::now() - start;
+        cout << (group_size == 0 ? string("iintersect_loop") : "iintersect_interleaved_" + to_string(group_size))
+             << '\t' << dist << '\t' << size << '\t' << queries.size() << '\t'
+             << elapsed.count() / queries.size() << "\t\t\t\t" << n_results << '\n';
+    }
+    // queries sorted by start, from the root and from a cursor
+    vector< pair< size_t, size_t > > sorted_queries(queries);
+    sort(sorted_queries.begin(), sorted_queries.end());
+    time_visitor_queries("sorted_for_each_intersection", dist, size, t, sorted_queries);
+    bi::itree_cursor< itree_type > cursor(t);
+    time_visitor_queries("sorted_cursor_iintersect", dist, size, cursor, sorted_queries);
+    // nearest neighbours of query starts
+    Sample s_prev_before;
+    n_results = 0;
+    for (const auto& q : queries)
+    {
+        s_prev_before.time([&] () { n_results += (t.prev_before(q.first) != t.end()); });
+    }
+    print_line("prev_before", dist, size, s_prev_before, n_results);
+    Sample s_nearest;
+    n_results = 0;
+    vector< const Value* > nearest_res;
+    for (const auto& q : queries)
+    {
+        nearest_res.clear();
+        s_nearest.time([&] () { t.nearest(q.first, 10, back_inserter(nearest_res)); });
+        n_results += nearest_res.size();
+    }
+    print_line("nearest_10", dist, size, s_nearest, n_results);
+    {
+        vector< Compact_Value > arena(size);
+        compact_value_traits::node_traits::set_arena(arena.data(), arena.size());
+        for (size_t i = 0; i < size; ++i)
+        {
+            arena[i]._start = v[i]._start;
+            arena[i]._end = v[i]._end;
+        }
+        compact_itree_type ct(arena.begin(), arena.end());
+        Sample s_compact;
+        n_results = 0;
+        for (const auto& q : queries)
+        {
+            s_compact.time([&] () {
+                ct.for_each_intersection(q.first, q.second, [&] (const Compact_Value&) { ++n_results; return true; });
+            });
+        }
+        print_line("compact_for_each_intersection", dist, size, s_compact, n_results);
+        ct.clear();
+    }
+    itree_type::frozen_type f = t.freeze();
+    size_t n_frozen_results = time_visitor_queries("frozen_iintersect", dist, size, f, queries);
+    btree_itree_type bt(v.begin(), v.end());
+    time_visitor_queries("btree_iintersect", dist, size, bt, queries);
+    // save the snapshot, then time opening it with mmap and querying it in place
+    Sample s_save;
+    s_save.time([&] () {
+        ofstream ofs(po.mapped_file, ios::binary);
+        bi::save_mapped_itree(ofs, f, [] (const Value& e) { return uint64_t(e._start); });
+    });
+    print_line("mapped_save", dist, size, s_save, f.size());
+    Sample s_open;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        s_open.time([&] () { bi::mapped_itree< size_t > m(po.mapped_file); });
+    }
+    print_line("mapped_open", dist, size, s_open, f.size());
+    {
+        bi::mapped_itree< size_t > m(po.mapped_file);
+        Sample s_mapped;
+        n_results = 0;
+        for (const auto& q : queries)
+        {
+            s_mapped.time([&] () {
+                m.for_each_intersection(q.first, q.second, [&] (size_t) { ++n_results; return true; });
+            });
+        }
+        print_line("mapped_iintersect", dist, size, s_mapped, n_results);
+    }
+    remove(po.mapped_file.c_str());
+    // a single sample for the whole batch, reported per query; skipped if
+    // the buffered results would not fit in memory
+    if (n_frozen_results <= po.parallel_max_results)
+    {
+        auto start = chrono::steady_clock::now();
+        n_results = bi::parallel_iintersect(f, queries.begin(), queries.end(), po.n_threads).size();
+        chrono::duration< double, nano > elapsed = chrono::steady_clock::now() - start;
+        cout << "parallel_frozen_iintersect\t" << dist << '\t' << size << '\t' << queries.size() << '\t'
+             << elapsed.count() / queries.size() << "\t\t\t\t" << n_results << '\n';
+    }
+    if (size <= po.naive_max)
+    {
+        size_t n_naive = min(po.n_naive_queries, queries.size());
+        Sample s_naive;
+        n_results = 0;
+        for (size_t i = 0; i < n_naive; ++i)
+        {
+            const auto& q = queries[i];
+            s_naive.time([&] () {
+                for (const auto& e : v)
+                {
+                    n_results += (e._start <= q.second and q.first <= e._end);
+                }
+            });
+        }
+        print_line("naive_iintersect", dist, size, s_naive, n_results);
+        // intervals sorted by start: scan up to the query end
+        Sample s_ms_query;
+        n_results = 0;
+        for (size_t i = 0; i < n_naive; ++i)
+        {
+            const auto& q = queries[i];
+            s_ms_query.time([&] () {
+                auto it_end = ms.upper_bound(make_pair(q.second, size_t(-1)));
+                for (auto it = ms.begin(); it != it_end; ++it)
+                {
+                    n_results += (q.first <= it->second);
+                }
+            });
+        }
+        print_line("multiset_iintersect", dist, size, s_ms_query, n_results);
+    }
+
+    // whole-tree operations
+    Sample s_clone;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        itree_type t2;
+        s_clone.time([&] () { t2.clone_from(t, new_cloner< Value >(), delete_disposer< Value >()); });
+        t2.clear_and_dispose(delete_disposer< Value >());
+    }
+    print_line("clone_from", dist, size, s_clone, t.size());
+    // pooled copies are laid out in tree order: cloning them again, and
+    // querying them, touches memory sequentially
+    Sample s_pooled_clone;
+    Sample s_pooled_reclone;
+    Sample s_pooled_clear;
+    bi::pooled_itree< itree_type > pt;
+    bi::pooled_itree< itree_type > pt2;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        s_pooled_clone.time([&] () { pt.clone_from(t); });
+        s_pooled_reclone.time([&] () { pt2.clone_from(pt); });
+        s_pooled_clear.time([&] () { pt2.clear(); });
+    }
+    print_line("pooled_clone_from", dist, size, s_pooled_clone, t.size());
+    print_line("pooled_clone_from_pooled", dist, size, s_pooled_reclone, t.size());
+    print_line("pooled_clear", dist, size, s_pooled_clear, t.size());
+    time_visitor_queries("pooled_for_each_intersection", dist, size, pt, queries);
+    pt.clear();
+    // persistent versions: each update copies one path, and the versions
+    // kept alive share all other nodes
+    typedef bi::persistent_itree< ITree_Value_Traits< Value > > persistent_itree_type;
+    persistent_itree_type pers(v.begin(), v.end());
+    Sample s_pers_update;
+    vector< persistent_itree_type > versions;
+    for (size_t i = 0; i < po.n_ops; ++i)
+    {
+        const Value& e = v[size_t(drand48() * v.size())];
+        s_pers_update.time([&] () {
+            pers.erase(e);
+            pers.insert(e);
+            versions.push_back(pers.snapshot());
+        });
+    }
+    print_line("persistent_update_snapshot", dist, size, s_pers_update, versions.size());
+    time_visitor_queries("persistent_iintersect", dist, size, versions.front(), queries);
+    versions.clear();
+    // all overlapping pairs with the extra intervals, jointly and by one query per interval
+    itree_type t_extra(extra.begin(), extra.end());
+    Sample s_join;
+    n_results = 0;
+    s_join.time([&] () {
+        bi::overlap_join(t_extra, t, [&] (const Value&, const Value&) { ++n_results; });
+    });
+    print_line("overlap_join", dist, size, s_join, n_results);
+    Sample s_join_queries;
+    n_results = 0;
+    s_join_queries.time([&] () {
+        for (const auto& e : extra)
+        {
+            t.for_each_intersection(e._start, e._end, [&] (const Value&) { ++n_results; return true; });
+        }
+    });
+    print_line("overlap_join_by_queries", dist, size, s_join_queries, n_results);
+    t_extra.clear();
+    // coordinate edits: the caller moves the elements, then informs the tree;
+    // both are timed, the tree bookkeeping alone takes O(1) and O(log n)
+    Sample s_shift;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        s_shift.time([&] () {
+            for (auto& e : t)
+            {
+                ++e._start;
+                ++e._end;
+            }
+            t.implement_shift(long(1));
+        });
+    }
+    print_line("implement_shift", dist, size, s_shift, t.size());
+    Sample s_shift_from;
+    n_results = 0;
+    for (size_t i = 0; i < 100 and i < queries.size(); ++i)
+    {
+        size_t pos = queries[i].first;
+        s_shift_from.time([&] () {
+            // intervals are in start order: move the suffix starting at pos
+            for (auto it = t.rbegin(); it != t.rend() and not (it->_start < pos); ++it)
+            {
+                ++it->_start;
+                ++it->_end;
+                ++n_results;
+            }
+            t.shift_from(pos, long(1));
+        });
+    }
+    print_line("shift_from", dist, size, s_shift_from, n_results);
+    t.clear();
+}
+
+void real_main(const Program_Options& po)
+{
+    srand48(po.seed);
+    print_header();
+    for (const auto& dist : po.dists)
+    {
+        for (auto size : po.sizes)
+        {
+            run(dist, size, po);
+        }
+    }
+}
+
+vector< string > split(const string& s)
+{
+    vector< string > res;
+    istringstream is(s);
+    string tok;
+    while (getline(is, tok, ','))
+    {
+        res.push_back(tok);
+    }
+    return res;
+}
+
+int main(int argc, char* argv[])
+{
+    Program_Options po;
+    string sizes;
+    string dists;
+    try
+    {
+        bo::options_description generic_opts_desc("Generic options");
+        bo::options_description config_opts_desc("Configuration options");
+        bo::options_description cmdline_opts_desc;
+        bo::options_description visible_opts_desc("Allowed options");
+        generic_opts_desc.add_options()
+            ("help,h", "produce help message")
+            ;
+        config_opts_desc.add_options()
+            ("sizes", bo::value<string>(&sizes)->default_value("1e3,1e4,1e5,1e6"), "comma-separated tree sizes, up to 1e8")
+            ("dists", bo::value<string>(&dists)->default_value("uniform,heavy,nested,long"), "comma-separated interval length distributions")
+            ("n-ops", bo::value<size_t>(&po.n_ops)->default_value(10000), "number of inserts, erases and shifts")
+            ("n-queries", bo::value<size_t>(&po.n_queries)->default_value(10000), "number of queries")
+            ("n-naive-queries", bo::value<size_t>(&po.n_naive_queries)->default_value(100), "number of queries for baseline scans")
+            ("naive-max", bo::value<size_t>(&po.naive_max)->default_value(1000000), "maximum tree size for baseline scans")
+            ("range-max", bo::value<size_t>(&po.range_max)->default_value(100000000), "maximum interval start")
+            ("max-len", bo::value<size_t>(&po.max_len)->default_value(1000), "maximum uniform interval length, and query length")
+            ("n-threads", bo::value<size_t>(&po.n_threads)->default_value(0), "threads for parallel queries (0: all cores)")
+            ("parallel-max-results", bo::value<size_t>(&po.parallel_max_results)->default_value(100000000), "skip parallel queries above this many results")
+            ("mapped-file", bo::value<string>(&po.mapped_file)->default_value("/tmp/bench-itree.map"), "temporary file for the mapped index")
+            ("seed", bo::value<size_t>(&po.seed)->default_value(0), "random number generator seed")
+            ;
+        cmdline_opts_desc.add(generic_opts_desc).add(config_opts_desc);
+        visible_opts_desc.add(generic_opts_desc).add(config_opts_desc);
+        bo::variables_map vm;
+        store(bo::command_line_parser(argc, argv).options(cmdline_opts_desc).run(), vm);
+        notify(vm);
+        if (vm.count("help"))
+        {
+            cout << visible_opts_desc;
+            exit(EXIT_SUCCESS);
+        }
+        if (po.seed == 0)
+        {
+            po.seed = time(NULL);
+        }
+        for (const auto& s : split(sizes))
+        {
+            // accept scientific notation
+            po.sizes.push_back(size_t(stod(s)));
+        }
+        po.dists = split(dists);
+        for (const auto& d : po.dists)
+        {
+            if (d != "uniform" and d != "heavy" and d != "nested" and d != "long")
+            {
+                throw runtime_error("unknown distribution: " + d);
+            }
+        }
+    }
+    catch(exception& e)
+    {
+        cout << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    real_main(po);
+    return EXIT_SUCCESS;
+}
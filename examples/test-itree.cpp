@@ -1,8 +1,29 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include <time.h>
 #include <boost/program_options.hpp>
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/itree.hpp>
+#include <boost/intrusive/btree_itree.hpp>
+#include <boost/intrusive/concurrent_itree.hpp>
+#include <boost/intrusive/sharded_itree.hpp>
+#include <boost/intrusive/itree_parallel.hpp>
+#include <boost/intrusive/mapped_itree.hpp>
+#include <boost/intrusive/itree_cursor.hpp>
+#include <boost/intrusive/compact_itree.hpp>
+#include <boost/intrusive/counting_itree.hpp>
+#include <boost/intrusive/pooled_itree.hpp>
+#include <boost/intrusive/persistent_itree.hpp>
 #include <boost/tti/tti.hpp>
 
 using namespace std;
@@ -15,6 +36,13 @@ namespace detail
     typedef bi::detail::extra_data_manager< void > extra_data_manager_check;
 }
 
+// aggregates maintained by augmented_itree_type
+typedef bi::itree_min_start_augment< size_t > min_start_augment;
+typedef bi::itree_max_length_augment< size_t > max_length_augment;
+typedef bi::itree_total_length_augment< size_t > total_length_augment;
+typedef bi::itree_augment_data< bi::itree_count_augment, min_start_augment,
+                                max_length_augment, total_length_augment > augment_data;
+
 struct Value
 {
     typedef Value* ptr_type;
@@ -22,7 +50,9 @@ struct Value
     Value() = default;
     Value(const Value& other)
         : _start(other._start), _end(other._end),
-          _parent(), _l_child(), _r_child(), _list_prev(), _list_next() {}
+          _parent(), _l_child(), _r_child(),
+          _e_parent(), _e_l_child(), _e_r_child(),
+          _list_prev(), _list_next() {}
 
     size_t _start;
     size_t _end;
@@ -32,6 +62,16 @@ struct Value
     ptr_type _r_child;
     int _col;
     size_t _max_end;
+    size_t _count;
+    size_t _min_end;
+    augment_data _aug;
+
+    ptr_type _e_parent;
+    ptr_type _e_l_child;
+    ptr_type _e_r_child;
+    int _e_col;
+    size_t _e_max_end;
+    size_t _e_count;
 
     ptr_type _list_prev;
     ptr_type _list_next;
@@ -42,18 +82,6 @@ typedef const Value* const_ptr_type;
 typedef Value& ref_type;
 typedef const Value& const_ref_type;
 
-ostream& operator <<(ostream& os, const Value& rhs)
-{
-    os << "[_start=" << rhs._start << ",_end=" << rhs._end
-       << ",_parent=" << rhs._parent
-       << ",_l_child=" << rhs._l_child
-       << ",_r_child=" << rhs._r_child
-       << ",_col=" << rhs._col
-       << ",_max_end=" << rhs._max_end
-       << "]";
-    return os;
-}
-
 bool intersect(const Value& lhs, const Value& rhs)
 {
     return (lhs._start <= rhs._start and rhs._start <= lhs._end)
@@ -81,6 +109,12 @@ struct ITree_Node_Traits
     static color red() { return 1; }
     static key_type get_max_end(const_node_ptr n) { return n->_max_end; }
     static void set_max_end(node_ptr n, key_type k) { n->_max_end = k ; }
+    static size_t get_count(const_node_ptr n) { return n->_count; }
+    static void set_count(node_ptr n, size_t c) { n->_count = c ; }
+    static key_type get_min_end(const_node_ptr n) { return n->_min_end; }
+    static void set_min_end(node_ptr n, key_type k) { n->_min_end = k ; }
+    static const augment_data& get_augment(const_node_ptr n) { return n->_aug; }
+    static void set_augment(node_ptr n, const augment_data& d) { n->_aug = d; }
 };
 
 template <class T>
@@ -104,6 +138,57 @@ struct ITree_Value_Traits
     static const_pointer to_value_ptr(const_node_ptr n) { return n; }
     static key_type get_start(const_pointer n) { return n->_start; }
     static key_type get_end(const_pointer n) { return n->_end; }
+    static void set_start(pointer n, key_type k) { n->_start = k; }
+    static void set_end(pointer n, key_type k) { n->_end = k; }
+};
+
+// second tree on the same values, keyed by interval end
+template <class T>
+struct End_Node_Traits
+{
+    typedef T node;
+    typedef node* node_ptr;
+    typedef const node* const_node_ptr;
+    typedef int color;
+    typedef size_t key_type;
+
+    static node_ptr get_parent(const_node_ptr n) { return n->_e_parent; }
+    static void set_parent(node_ptr n, node_ptr ptr) { n->_e_parent = ptr; }
+    static node_ptr get_left(const_node_ptr n) { return n->_e_l_child; }
+    static void set_left(node_ptr n, node_ptr ptr) { n->_e_l_child = ptr; }
+    static node_ptr get_right(const_node_ptr n) { return n->_e_r_child; }
+    static void set_right(node_ptr n, node_ptr ptr) { n->_e_r_child = ptr; }
+    static color get_color(const_node_ptr n) { return n->_e_col; }
+    static void set_color(node_ptr n, color c) { n->_e_col = c ; }
+    static color black() { return 0; }
+    static color red() { return 1; }
+    static key_type get_max_end(const_node_ptr n) { return n->_e_max_end; }
+    static void set_max_end(node_ptr n, key_type k) { n->_e_max_end = k ; }
+    static size_t get_count(const_node_ptr n) { return n->_e_count; }
+    static void set_count(node_ptr n, size_t c) { n->_e_count = c ; }
+};
+
+template <class T>
+struct End_Value_Traits
+{
+    typedef T value_type;
+    typedef End_Node_Traits< T > node_traits;
+    typedef typename node_traits::key_type key_type;
+    typedef typename node_traits::node_ptr node_ptr;
+    typedef typename node_traits::const_node_ptr const_node_ptr;
+    typedef node_ptr pointer;
+    typedef const_node_ptr const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    static const bi::link_mode_type link_mode = bi::safe_link;
+
+    static node_ptr to_node_ptr (reference value) { return &value; }
+    static const_node_ptr to_node_ptr (const_reference value) { return &value; }
+    static pointer to_value_ptr(node_ptr n) { return n; }
+    static const_pointer to_value_ptr(const_node_ptr n) { return n; }
+    static key_type get_start(const_pointer n) { return n->_end; }
+    static key_type get_end(const_pointer n) { return n->_end; }
 };
 
 template <class T>
@@ -141,8 +226,221 @@ struct List_Value_Traits
 
 typedef bi::itree< Value, bi::value_traits< ITree_Value_Traits< Value > > > itree_type;
 typedef itree_type::itree_algo itree_algo;
+typedef bi::itree< Value, bi::value_traits< End_Value_Traits< Value > > > end_itree_type;
+typedef bi::itree< Value, bi::value_traits< ITree_Value_Traits< Value > >,
+                   bi::itree_stats< bi::itree_query_stats > > stats_itree_type;
+typedef bi::itree< Value, bi::value_traits< ITree_Value_Traits< Value > >,
+                   bi::itree_augment< bi::itree_count_augment, min_start_augment,
+                                      max_length_augment, total_length_augment > > augmented_itree_type;
+// small nodes, to exercise splits and merges
+typedef bi::btree_itree< ITree_Value_Traits< Value >, 8, 8 > btree_itree_type;
 typedef bi::list< Value, bi::value_traits< List_Value_Traits< Value > > > list_type;
 
+ostream& operator <<(ostream& os, const Value& rhs)
+{
+    // the _max_end field holds a distance to _end: print the absolute value
+    os << "[_start=" << rhs._start << ",_end=" << rhs._end
+       << ",_parent=" << rhs._parent
+       << ",_l_child=" << rhs._l_child
+       << ",_r_child=" << rhs._r_child
+       << ",_col=" << rhs._col
+       << ",max_end=" << itree_type::Node_Traits::get_max_end(&rhs)
+       << ",_count=" << rhs._count
+       << "]";
+    return os;
+}
+
+// values with other key types, for the edge cases of endpoint storage
+template < class Key >
+struct Key_Value
+{
+    Key _start;
+    Key _end;
+    Key_Value* _parent;
+    Key_Value* _l_child;
+    Key_Value* _r_child;
+    int _col;
+    Key _max_end;
+    Key _min_end;
+};
+
+template < class Key >
+struct Key_Node_Traits
+{
+    typedef Key_Value< Key > node;
+    typedef node* node_ptr;
+    typedef const node* const_node_ptr;
+    typedef int color;
+    typedef Key key_type;
+
+    static node_ptr get_parent(const_node_ptr n) { return n->_parent; }
+    static void set_parent(node_ptr n, node_ptr ptr) { n->_parent = ptr; }
+    static node_ptr get_left(const_node_ptr n) { return n->_l_child; }
+    static void set_left(node_ptr n, node_ptr ptr) { n->_l_child = ptr; }
+    static node_ptr get_right(const_node_ptr n) { return n->_r_child; }
+    static void set_right(node_ptr n, node_ptr ptr) { n->_r_child = ptr; }
+    static color get_color(const_node_ptr n) { return n->_col; }
+    static void set_color(node_ptr n, color c) { n->_col = c ; }
+    static color black() { return 0; }
+    static color red() { return 1; }
+    static key_type get_max_end(const_node_ptr n) { return n->_max_end; }
+    static void set_max_end(node_ptr n, key_type k) { n->_max_end = k ; }
+    static key_type get_min_end(const_node_ptr n) { return n->_min_end; }
+    static void set_min_end(node_ptr n, key_type k) { n->_min_end = k ; }
+};
+
+template < class Key >
+struct Key_Value_Traits
+{
+    typedef Key_Value< Key > value_type;
+    typedef Key_Node_Traits< Key > node_traits;
+    typedef Key key_type;
+    typedef typename node_traits::node_ptr node_ptr;
+    typedef typename node_traits::const_node_ptr const_node_ptr;
+    typedef node_ptr pointer;
+    typedef const_node_ptr const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    static const bi::link_mode_type link_mode = bi::normal_link;
+
+    static node_ptr to_node_ptr (reference value) { return &value; }
+    static const_node_ptr to_node_ptr (const_reference value) { return &value; }
+    static pointer to_value_ptr(node_ptr n) { return n; }
+    static const_pointer to_value_ptr(const_node_ptr n) { return n; }
+    static key_type get_start(const_pointer n) { return n->_start; }
+    static key_type get_end(const_pointer n) { return n->_end; }
+};
+
+/** Check intersection and containment queries against a naive scan, for
+ * intervals whose endpoints are far apart, or not integral.
+ */
+template < class Key >
+void check_key_edge_case(const vector< pair< Key, Key > >& intervals, Key q_start, Key q_end)
+{
+    typedef bi::itree< Key_Value< Key >, bi::value_traits< Key_Value_Traits< Key > > > key_itree_type;
+    vector< Key_Value< Key > > v(intervals.size());
+    key_itree_type t;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i]._start = intervals[i].first;
+        v[i]._end = intervals[i].second;
+        t.insert(v[i]);
+    }
+    size_t n_intersect = 0;
+    size_t n_contained = 0;
+    for (const auto& e : v)
+    {
+        n_intersect += not (e._end < q_start or q_end < e._start);
+        n_contained += not (e._start < q_start or q_end < e._end);
+    }
+    size_t res_intersect = 0;
+    size_t res_contained = 0;
+    t.for_each_intersection(q_start, q_end, [&] (const Key_Value< Key >&) { ++res_intersect; return true; });
+    for (const auto& e : t.icontained_in(q_start, q_end))
+    {
+        (void)e;
+        ++res_contained;
+    }
+    if (res_intersect != n_intersect or res_contained != n_contained)
+    {
+        clog << "key edge case error: intersect " << res_intersect << '/' << n_intersect
+             << " contained " << res_contained << '/' << n_contained << '\n';
+        exit(EXIT_FAILURE);
+    }
+    t.clear();
+}
+
+/** Check that implement_shift() works before or after the elements are shifted. */
+template < typename Key >
+void check_implement_shift(Key delta)
+{
+    typedef bi::itree< Key_Value< Key >, bi::value_traits< Key_Value_Traits< Key > > > key_itree_type;
+    vector< Key_Value< Key > > v(20);
+    key_itree_type t;
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i]._start = Key(i % 7) * 10;
+        v[i]._end = v[i]._start + Key(i % 3) * 25;
+        t.insert(v[i]);
+    }
+    for (int round = 0; round < 2; ++round)
+    {
+        if (round == 0)
+        {
+            t.implement_shift(delta);
+        }
+        for (auto& e : v)
+        {
+            e._start += delta;
+            e._end += delta;
+        }
+        if (round == 1)
+        {
+            t.implement_shift(delta);
+        }
+        for (Key q = Key(-50) + delta * (round + 1); q < Key(150) + delta * (round + 1); q += 5)
+        {
+            size_t n_naive = size_t(count_if(v.begin(), v.end(),
+                [&] (const Key_Value< Key >& e) { return not (e._end < q or q < e._start); }));
+            size_t n_res = 0;
+            t.for_each_intersection(q, q, [&] (const Key_Value< Key >&) { ++n_res; return true; });
+            if (n_res != n_naive or t.max_end() != max_element(v.begin(), v.end(),
+                    [] (const Key_Value< Key >& lhs, const Key_Value< Key >& rhs) { return lhs._end < rhs._end; })->_end)
+            {
+                clog << "implement_shift error: round " << round << " point " << q << '\n';
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    t.clear();
+}
+
+void check_key_edge_cases()
+{
+    // max_end - end rounds with floating point keys
+    check_key_edge_case< double >({ { -1e11, -1e11 }, { -77702617110.2077, -77702617110.2077 },
+                                    { -1, 0.0006761479843958773 } }, 0.000675, 0.000675);
+    // distances between signed endpoints overflow the key type
+    const int64_t lo = numeric_limits< int64_t >::min();
+    const int64_t hi = numeric_limits< int64_t >::max();
+    check_key_edge_case< int64_t >({ { lo, lo }, { lo + 1, hi - 1 }, { 0, 1 }, { lo, lo + 1 } }, hi - 2, hi - 2);
+    check_key_edge_case< int64_t >({ { -5, hi }, { hi - 1, hi }, { lo, hi }, { 0, 1 } }, lo, lo + 1);
+    check_key_edge_case< int64_t >({ { lo, hi }, { hi - 1, hi }, { 0, 1 } }, 0, hi);
+    check_key_edge_case< int32_t >({ { -2000000000, -2000000000 }, { -1999999999, 2000000000 }, { 3, 4 } },
+                                   1999999999, 1999999999);
+    // distances from the point to the nearest intervals overflow the key type
+    {
+        typedef bi::itree< Key_Value< int64_t >, bi::value_traits< Key_Value_Traits< int64_t > > > key_itree_type;
+        vector< Key_Value< int64_t > > v(3);
+        v[0]._start = v[0]._end = lo;
+        v[1]._start = v[1]._end = hi;
+        v[2]._start = v[2]._end = lo + 2;
+        key_itree_type t(v.begin(), v.end());
+        vector< const Key_Value< int64_t >* > res;
+        t.nearest(0, 3, back_inserter(res));
+        if (res.size() != 3 or res[0] != &v[2] or res[1] != &v[1] or res[2] != &v[0])
+        {
+            clog << "key edge case error: nearest\n";
+            exit(EXIT_FAILURE);
+        }
+        t.clear();
+    }
+    check_implement_shift< double >(-37.5);
+    check_implement_shift< int64_t >(-37);
+}
+
+// nodes with 32-bit links and max_end, in an arena
+struct Compact_Value : public bi::compact_itree_node< uint32_t >
+{
+    size_t _start;
+    size_t _end;
+};
+static_assert(sizeof(bi::compact_itree_node< uint32_t >) == 16, "compact node bookkeeping should take 16 bytes");
+typedef bi::compact_itree_value_traits< Compact_Value, size_t, &Compact_Value::_start, &Compact_Value::_end,
+                                        uint32_t > compact_value_traits;
+typedef bi::compact_itree< bi::itree< Compact_Value, bi::value_traits< compact_value_traits > > > compact_itree_type;
+
 static_assert(
     bi::detail::extra_data_manager<
         bi::detail::ITree_Node_Traits < ITree_Value_Traits< Value > >
@@ -168,7 +466,7 @@ struct new_cloner
     }
 };
 
-const_ptr_type get_root(itree_type& t)
+const_ptr_type get_root(const itree_type& t)
 {
     return itree_algo::get_header(&*t.begin())->_parent;
 }
@@ -184,42 +482,79 @@ void print_sub_tree(const_ptr_type r, size_t depth)
     {
         clog << "  ";
     }
-    clog << '[' << r->_start << ',' << r->_end << "] " << r->_max_end << '\n';
+    clog << '[' << r->_start << ',' << r->_end << "] " << itree_type::Node_Traits::get_max_end(r) << '\n';
     print_sub_tree(r->_r_child, depth + 1);
 }
 
-void print_tree(itree_type& t)
+void print_tree(const itree_type& t)
 {
     print_sub_tree(get_root(t), 0);
 }
 
-bool check_max_ends(const_ptr_type node_ptr, size_t& max_end)
+bool check_max_ends(const_ptr_type node_ptr, size_t& max_end, size_t& min_end)
 {
     if (!node_ptr)
     {
         max_end = 0;
+        min_end = size_t(-1);
         return true;
     }
     size_t max_end_left;
     size_t max_end_right;
-    if (not check_max_ends(node_ptr->_l_child, max_end_left) or not check_max_ends(node_ptr->_r_child, max_end_right))
+    size_t min_end_left;
+    size_t min_end_right;
+    if (not check_max_ends(node_ptr->_l_child, max_end_left, min_end_left)
+        or not check_max_ends(node_ptr->_r_child, max_end_right, min_end_right))
     {
         return false;
     }
-    if (node_ptr->_max_end != max(node_ptr->_end, max(max_end_left, max_end_right)))
+    // max_end and min_end are stored relative to the node end
+    max_end = itree_type::Node_Traits::get_max_end(node_ptr);
+    min_end = itree_type::Node_Traits::get_min_end(node_ptr);
+    if (max_end != max(node_ptr->_end, max(max_end_left, max_end_right)))
     {
         clog << "_max_end error: " << *node_ptr << '\n';
         return false;
     }
-    max_end = node_ptr->_max_end;
+    if (min_end != min(node_ptr->_end, min(min_end_left, min_end_right)))
+    {
+        clog << "_min_end error: " << *node_ptr << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool check_counts(const_ptr_type node_ptr, size_t& count)
+{
+    if (!node_ptr)
+    {
+        count = 0;
+        return true;
+    }
+    size_t count_left;
+    size_t count_right;
+    if (not check_counts(node_ptr->_l_child, count_left) or not check_counts(node_ptr->_r_child, count_right))
+    {
+        return false;
+    }
+    if (node_ptr->_count != 1 + count_left + count_right)
+    {
+        clog << "_count error: " << *node_ptr << '\n';
+        return false;
+    }
+    count = node_ptr->_count;
     return true;
 }
 
-void check_max_ends(itree_type& t)
+void check_max_ends(const itree_type& t)
 {
     const_ptr_type root_node = get_root(t);
     size_t max_end;
-    if (not check_max_ends(root_node, max_end))
+    size_t min_end;
+    size_t count;
+    if (not check_max_ends(root_node, max_end, min_end) or not check_counts(root_node, count)
+        or not is_sorted(t.begin(), t.end(),
+                         [] (const Value& lhs, const Value& rhs) { return lhs._start < rhs._start; }))
     {
         clog << "tree:\n";
         for (auto const& e :t)
@@ -231,41 +566,311 @@ void check_max_ends(itree_type& t)
     }
 }
 
-struct Program_Options
+// check the aggregate of a policy in every node, and return that of the subtree
+template < class Policy >
+bool check_aggregates(const_ptr_type node_ptr, typename Policy::value_type& agg)
 {
-    size_t max_load;
-    size_t range_max;
-    size_t n_ops;
-    size_t seed;
-    bool print_tree_each_op;
-};
+    typedef augmented_itree_type::Node_Traits node_traits;
+    if (!node_ptr)
+    {
+        agg = Policy::identity();
+        return true;
+    }
+    typename Policy::value_type agg_left;
+    typename Policy::value_type agg_right;
+    if (not check_aggregates< Policy >(node_ptr->_l_child, agg_left)
+        or not check_aggregates< Policy >(node_ptr->_r_child, agg_right))
+    {
+        return false;
+    }
+    agg = Policy::combine(Policy::combine(agg_left, Policy::from_value(*node_ptr, node_ptr->_start, node_ptr->_end)),
+                          agg_right);
+    if (node_traits::get_aggregate< Policy >(node_ptr) != agg)
+    {
+        clog << "aggregate error: " << *node_ptr << '\n';
+        return false;
+    }
+    return true;
+}
 
+template < class Policy >
+typename Policy::value_type naive_aggregate(const augmented_itree_type& t, size_t lo, size_t hi)
+{
+    typename Policy::value_type res = Policy::identity();
+    for (const auto& e : t)
+    {
+        if (lo <= e._start and e._start <= hi)
+        {
+            res = Policy::combine(res, Policy::from_value(e, e._start, e._end));
+        }
+    }
+    return res;
+}
 
-void real_main(const Program_Options& po)
+template < class Policy >
+bool check_aggregate_queries(const augmented_itree_type& t, size_t lo, size_t hi)
 {
-    clog << "----- program options:"
-         << "\nmax_load=" << po.max_load
-         << "\nrange_max=" << po.range_max
-         << "\nn_ops=" << po.n_ops
-         << "\nseed=" << po.seed << '\n';
+    typename Policy::value_type agg;
+    const_ptr_type root = (t.empty() ? nullptr : augmented_itree_type::itree_algo::get_header(&*t.begin())->_parent);
+    return (check_aggregates< Policy >(root, agg)
+            and t.aggregate< Policy >() == naive_aggregate< Policy >(t, 0, size_t(-1))
+            and t.aggregate_start_range< Policy >(lo, hi) == naive_aggregate< Policy >(t, lo, hi));
+}
 
-    clog << "----- constructing iitree & ilist\n";
-    itree_type t;
-    list_type l;
+void check_augmented(const augmented_itree_type& t, size_t range_max)
+{
+    size_t e1 = size_t(drand48() * range_max);
+    size_t e2 = size_t(drand48() * range_max);
+    size_t lo = min(e1, e2);
+    size_t hi = max(e1, e2);
+    size_t min_len = size_t(drand48() * range_max / 2);
+    vector< const_ptr_type > naive_long;
+    for (const auto& e : t)
+    {
+        if (e._end - e._start >= min_len)
+        {
+            naive_long.push_back(&e);
+        }
+    }
+    vector< const_ptr_type > res_long;
+    t.for_each_if< max_length_augment >([&] (size_t len) { return len >= min_len; },
+                                        [&] (const Value& e) { res_long.push_back(&e); return true; });
+    if (not check_aggregate_queries< bi::itree_count_augment >(t, lo, hi)
+        or not check_aggregate_queries< min_start_augment >(t, lo, hi)
+        or not check_aggregate_queries< max_length_augment >(t, lo, hi)
+        or not check_aggregate_queries< total_length_augment >(t, lo, hi)
+        or res_long != naive_long)
+    {
+        clog << "augmented itree error\n";
+        exit(EXIT_FAILURE);
+    }
+}
 
-    clog << "----- initializing random number generator\n";
-    srand48(po.seed);
+bool check_colors(const_ptr_type node_ptr, size_t& black_height)
+{
+    typedef ITree_Node_Traits< Value > node_traits;
+    if (!node_ptr)
+    {
+        black_height = 0;
+        return true;
+    }
+    size_t black_height_left;
+    size_t black_height_right;
+    if (not check_colors(node_ptr->_l_child, black_height_left) or not check_colors(node_ptr->_r_child, black_height_right))
+    {
+        return false;
+    }
+    if (black_height_left != black_height_right
+        or (node_ptr->_col == node_traits::red()
+            and ((node_ptr->_l_child and node_ptr->_l_child->_col == node_traits::red())
+                 or (node_ptr->_r_child and node_ptr->_r_child->_col == node_traits::red()))))
+    {
+        clog << "color error: " << *node_ptr << '\n';
+        return false;
+    }
+    black_height = black_height_left + (node_ptr->_col == node_traits::black() ? 1 : 0);
+    return true;
+}
 
-    clog << "----- main loop\n";
-    for (size_t i = 0; i < po.n_ops; ++i)
+void check_colors(itree_type& t)
+{
+    const_ptr_type root_node = get_root(t);
+    size_t black_height;
+    if ((root_node and root_node->_col != ITree_Node_Traits< Value >::black())
+        or not check_colors(root_node, black_height))
     {
-        int op = int(drand48()*5);
-        if (op == 0)
+        print_tree(t);
+        exit(1);
+    }
+}
+
+/** Index whose queries fail on one thread, and are slow on the others. */
+struct Throwing_Index
+{
+    typedef Value value_type;
+
+    template < class Visitor >
+    bool for_each_intersection(size_t, size_t, Visitor&&) const
+    {
+        if (this_thread::get_id() == thrower)
         {
-            // insert new element
-            if (l.size() >= po.max_load)
+            throw runtime_error("query failed");
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+        return true;
+    }
+
+    thread::id thrower;
+};
+
+/** Check that parallel_iintersect() joins its workers before an exception
+ * from the calling thread propagates (destroying joinable threads would
+ * terminate the program).
+ */
+void check_parallel_exception()
+{
+    Throwing_Index index;
+    index.thrower = this_thread::get_id();
+    vector< pair< size_t, size_t > > queries(64, make_pair(size_t(0), size_t(1)));
+    bool thrown = false;
+    try
+    {
+        bi::parallel_iintersect(index, queries.begin(), queries.end(), 4, 1);
+    }
+    catch (const runtime_error&)
+    {
+        thrown = true;
+    }
+    if (not thrown)
+    {
+        clog << "parallel query exception lost\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+/** Stress concurrent_itree with reader threads querying while the writer
+ * publishes. Every published tree holds exactly n_values elements; erased
+ * elements are poisoned and deleted through defer(), so a reader seeing an
+ * element after its reclamation reads a poisoned or freed value (the latter
+ * is reported under ASan).
+ */
+void check_concurrent_itree(size_t n_readers, size_t n_publishes, size_t range_max)
+{
+    const size_t n_values = 100;
+    const size_t poison = size_t(-1);
+    itree_type t;
+    vector< ptr_type > live;
+    for (size_t i = 0; i < n_values; ++i)
+    {
+        ptr_type a = new Value();
+        a->_start = size_t(drand48() * range_max);
+        a->_end = a->_start + size_t(drand48() * range_max / 10);
+        live.push_back(a);
+        t.insert(*a);
+    }
+    bi::concurrent_itree< itree_type > ct(n_readers);
+    ct.publish(t);
+    atomic< bool > done(false);
+    atomic< bool > failed(false);
+    vector< thread > readers;
+    for (size_t slot = 0; slot < n_readers; ++slot)
+    {
+        readers.emplace_back([&, slot] () {
+            size_t seed = slot;
+            while (not done.load() and not failed.load())
             {
-                continue;
+                // per-thread LCG: drand48() is not thread-safe
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                size_t q_start = (seed >> 33) % (range_max + 1);
+                size_t q_end = q_start + (seed >> 13) % (range_max / 10 + 1);
+                bi::concurrent_itree< itree_type >::read_guard g(ct, slot);
+                vector< const_ptr_type > all;
+                g->iintersect(0, poison - 1, back_inserter(all));
+                size_t n_naive = 0;
+                for (auto p : all)
+                {
+                    n_naive += (p->_start != poison and p->_start <= q_end and q_start <= p->_end);
+                    if (p->_start == poison or p->_end < p->_start)
+                    {
+                        failed.store(true);
+                    }
+                }
+                size_t n_res = 0;
+                g->for_each_intersection(q_start, q_end, [&] (const Value&) { ++n_res; return true; });
+                if (all.size() != n_values or n_res != n_naive)
+                {
+                    failed.store(true);
+                }
+            }
+        });
+    }
+    for (size_t i = 0; i < n_publishes and not failed.load(); ++i)
+    {
+        // replace a few elements, then publish the batch
+        for (size_t j = 0; j < 5; ++j)
+        {
+            size_t k = size_t(drand48() * live.size());
+            ptr_type old_value = live[k];
+            t.erase(t.iterator_to(*old_value));
+            ct.defer([old_value, poison] () {
+                old_value->_start = poison;
+                old_value->_end = poison;
+                delete old_value;
+            });
+            ptr_type a = new Value();
+            a->_start = size_t(drand48() * range_max);
+            a->_end = a->_start + size_t(drand48() * range_max / 10);
+            live[k] = a;
+            t.insert(*a);
+        }
+        ct.publish(t);
+        if (i % 16 == 0)
+        {
+            this_thread::yield();
+        }
+    }
+    done.store(true);
+    for (auto& r : readers)
+    {
+        r.join();
+    }
+    if (failed.load())
+    {
+        clog << "concurrent itree reader error\n";
+        exit(EXIT_FAILURE);
+    }
+    t.clear();
+    for (auto p : live)
+    {
+        delete p;
+    }
+}
+
+struct Program_Options
+{
+    size_t max_load;
+    size_t range_max;
+    size_t n_ops;
+    size_t seed;
+    bool print_tree_each_op;
+};
+
+
+void real_main(const Program_Options& po)
+{
+    clog << "----- program options:"
+         << "\nmax_load=" << po.max_load
+         << "\nrange_max=" << po.range_max
+         << "\nn_ops=" << po.n_ops
+         << "\nseed=" << po.seed << '\n';
+
+    clog << "----- constructing iitree & ilist\n";
+    itree_type t;
+    end_itree_type end_t;
+    btree_itree_type bt;
+    bi::concurrent_itree< itree_type > ct(1);
+    list_type l;
+
+    clog << "----- checking endpoint storage edge cases\n";
+    check_key_edge_cases();
+
+    clog << "----- initializing random number generator\n";
+    srand48(po.seed);
+
+    clog << "----- checking concurrent readers\n";
+    check_concurrent_itree(4, 2000, po.range_max);
+    check_parallel_exception();
+
+    clog << "----- main loop\n";
+    for (size_t i = 0; i < po.n_ops; ++i)
+    {
+        int op = int(drand48()*23);
+        if (op == 0)
+        {
+            // insert new element
+            if (l.size() >= po.max_load)
+            {
+                continue;
             }
             ptr_type a = new Value();
             size_t e1 = size_t(drand48() * po.range_max);
@@ -275,6 +880,8 @@ void real_main(const Program_Options& po)
             clog << "adding: " << *a << '\n';
             l.push_back(*a);
             t.insert(*a);
+            end_t.insert(*a);
+            bt.insert(*a);
         }
         else if (op == 1)
         {
@@ -294,6 +901,12 @@ void real_main(const Program_Options& po)
             clog << "deleting: " << *a << '\n';
             l.erase(it);
             t.erase(t.iterator_to(*a));
+            end_t.erase(end_t.iterator_to(*a));
+            if (not bt.erase(*a))
+            {
+                clog << "btree erase error\n";
+                exit(EXIT_FAILURE);
+            }
             delete a;
         }
         else if (op == 2)
@@ -325,7 +938,35 @@ void real_main(const Program_Options& po)
                 (void)r;
                 ++res_iterator_range;
             }
-            if (res_iterator_range != res_list)
+            // count with visitor, and stop at the first intersection
+            size_t res_visitor = 0;
+            t.for_each_intersection(e1, e2, [&] (const Value& v) {
+                res_visitor += intersect(v, *a) ? 1 : l.size() + 1;
+                return true;
+            });
+            size_t res_visitor_first = 0;
+            bool visitor_done = t.for_each_intersection(e1, e2, [&] (const Value&) {
+                ++res_visitor_first;
+                return false;
+            });
+            if (res_visitor_first != min(res_list, size_t(1)) or visitor_done != (res_list == 0))
+            {
+                res_visitor = l.size() + 1;
+            }
+            // count with btree
+            size_t res_btree = 0;
+            bt.for_each_intersection(e1, e2, [&] (const Value& v) {
+                res_btree += intersect(v, *a) ? 1 : l.size() + 1;
+                return true;
+            });
+            if (bt.size() != l.size())
+            {
+                res_btree = l.size() + 1;
+            }
+            // count with subtree counts
+            size_t res_count = t.iintersect_count(e1, e2, end_t);
+            if (res_iterator_range != res_list or res_visitor != res_list or res_btree != res_list
+                or res_count != res_list)
             {
                 clog << "wrong intersection with " << *a << '\n';
                 clog << "list:\n";
@@ -365,6 +1006,1038 @@ void real_main(const Program_Options& po)
                 delete tmp;
             }
         }
+        else if (op == 5)
+        {
+            // bulk load copies of all elements and check
+            clog << "bulk loading tree of size: " << l.size() << '\n';
+            vector< Value > v(l.begin(), l.end());
+            size_t half = v.size() / 2;
+            itree_type t2(v.begin() + half, v.end());
+            t2.bulk_load(v.begin(), v.begin() + half);
+            clog << "checking bulk loaded tree of size: " << t2.size() << '\n';
+            check_max_ends(t2);
+            check_colors(t2);
+            if (t2.size() != t.size()
+                or not equal(t.begin(), t.end(), t2.begin(),
+                             [] (const Value& lhs, const Value& rhs) { return lhs._start == rhs._start; }))
+            {
+                clog << "bulk load error\n";
+                print_tree(t2);
+                exit(EXIT_FAILURE);
+            }
+            t2.clear();
+            // load the copies again in a tree with query statistics
+            stats_itree_type t3(v.begin(), v.end());
+            size_t e1 = size_t(drand48() * po.range_max);
+            size_t e2 = size_t(drand48() * po.range_max);
+            if (e1 > e2)
+            {
+                swap(e1, e2);
+            }
+            size_t res_iterator_range = 0;
+            for (const auto& r : t3.iintersect(e1, e2))
+            {
+                (void)r;
+                ++res_iterator_range;
+            }
+            bi::itree_query_stats::counters c_iterator_range = t3.stats().last;
+            size_t res_visitor = 0;
+            t3.for_each_intersection(e1, e2, [&] (const Value&) { ++res_visitor; return true; });
+            bi::itree_query_stats::counters c_visitor = t3.stats().last;
+            size_t res_stab = 0;
+            for (const auto& r : t3.istab(e1))
+            {
+                (void)r;
+                ++res_stab;
+            }
+            bi::itree_query_stats::counters c_stab = t3.stats().last;
+            if (c_iterator_range.reported != res_iterator_range or c_visitor.reported != res_visitor
+                or c_stab.reported != res_stab or t3.stats().total.n_queries != 3
+                or c_iterator_range.visited > t3.size() or c_visitor.visited > t3.size()
+                or c_stab.visited > t3.size()
+                or t3.stats().total.reported != res_iterator_range + res_visitor + res_stab)
+            {
+                clog << "query stats error\n";
+                exit(EXIT_FAILURE);
+            }
+            t3.clear();
+        }
+        else if (op == 6)
+        {
+            // compute intersections with a batch of intervals
+            size_t n_queries = size_t(drand48() * 10);
+            vector< pair< size_t, size_t > > queries;
+            for (size_t j = 0; j < n_queries; ++j)
+            {
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                queries.push_back(make_pair(min(e1, e2), max(e1, e2)));
+            }
+            clog << "checking batch intersection with " << n_queries << " intervals\n";
+            vector< size_t > res_batch(n_queries, 0);
+            t.iintersect_batch(queries.begin(), queries.end(),
+                               [&] (size_t q, const Value&) { ++res_batch[q]; });
+            // parallel batch must match sequential queries, in the same order
+            vector< pair< size_t, const_ptr_type > > res_sequential;
+            for (size_t j = 0; j < n_queries; ++j)
+            {
+                t.for_each_intersection(queries[j].first, queries[j].second, [&] (const Value& v) {
+                    res_sequential.push_back(make_pair(j, &v));
+                    return true;
+                });
+            }
+            if (bi::parallel_iintersect(t, queries.begin(), queries.end(), 3, 2).merged() != res_sequential)
+            {
+                clog << "wrong parallel batch intersection\n";
+                print_tree(t);
+                exit(EXIT_FAILURE);
+            }
+            // interleaved batch must match sequential queries, in the same order for each query
+            vector< vector< const_ptr_type > > res_interleaved(n_queries);
+            t.iintersect_interleaved(queries.begin(), queries.end(),
+                                     [&] (size_t q, const Value& v) { res_interleaved[q].push_back(&v); },
+                                     size_t(1 + drand48() * 16));
+            vector< pair< size_t, const_ptr_type > > res_interleaved_merged;
+            for (size_t j = 0; j < n_queries; ++j)
+            {
+                for (auto v : res_interleaved[j])
+                {
+                    res_interleaved_merged.push_back(make_pair(j, v));
+                }
+            }
+            if (res_interleaved_merged != res_sequential)
+            {
+                clog << "wrong interleaved batch intersection\n";
+                print_tree(t);
+                exit(EXIT_FAILURE);
+            }
+            for (size_t j = 0; j < n_queries; ++j)
+            {
+                Value a;
+                a._start = queries[j].first;
+                a._end = queries[j].second;
+                size_t res_list = 0;
+                for (const auto& v : l)
+                {
+                    if (intersect(v, a))
+                    {
+                        ++res_list;
+                    }
+                }
+                if (res_batch[j] != res_list)
+                {
+                    clog << "wrong batch intersection with " << a << '\n';
+                    print_tree(t);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            clog << "batch intersection ok\n";
+        }
+        else if (op == 7)
+        {
+            // compute intervals containing some point
+            Value a;
+            a._start = a._end = size_t(drand48() * po.range_max);
+            clog << "checking stab with: " << a._start << '\n';
+            size_t res_list = 0;
+            for (const auto& v : l)
+            {
+                if (intersect(v, a))
+                {
+                    ++res_list;
+                }
+            }
+            size_t res_stab = 0;
+            for (const auto& r : t.istab(a._start))
+            {
+                if (not intersect(r, a))
+                {
+                    res_stab = l.size() + 1;
+                    break;
+                }
+                ++res_stab;
+            }
+            if (res_stab != res_list)
+            {
+                clog << "wrong stab with " << a << '\n';
+                print_tree(t);
+                exit(EXIT_FAILURE);
+            }
+            clog << "stab ok, size = " << res_list << " / " << l.size() << '\n';
+        }
+        else if (op == 8)
+        {
+            // freeze tree and check intersections
+            clog << "freezing tree of size: " << t.size() << '\n';
+            itree_type::frozen_type f = t.freeze();
+            for (size_t j = 0; j < 10; ++j)
+            {
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                if (e1 > e2)
+                {
+                    swap(e1, e2);
+                }
+                vector< const_ptr_type > res_tree;
+                for (const auto& r : t.iintersect(e1, e2))
+                {
+                    res_tree.push_back(&r);
+                }
+                vector< const_ptr_type > res_frozen;
+                f.iintersect(e1, e2, back_inserter(res_frozen));
+                ct.publish(t);
+                vector< const_ptr_type > res_published;
+                ct.iintersect(0, e1, e2, back_inserter(res_published));
+                if (res_frozen != res_tree or res_published != res_tree)
+                {
+                    clog << "wrong frozen intersection with [" << e1 << "," << e2 << "]\n";
+                    print_tree(t);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            clog << "frozen intersection ok\n";
+        }
+        else if (op == 9)
+        {
+            // load copies of all elements in a sharded tree and check intersections
+            vector< size_t > boundaries(size_t(drand48() * 4));
+            for (auto& b : boundaries)
+            {
+                b = size_t(drand48() * po.range_max);
+            }
+            sort(boundaries.begin(), boundaries.end());
+            clog << "sharding tree of size: " << l.size() << " into " << boundaries.size() + 1 << " shards\n";
+            vector< Value > v(l.begin(), l.end());
+            bi::sharded_itree< itree_type > st(boundaries.begin(), boundaries.end());
+            size_t half = v.size() / 2;
+            st.insert_parallel(v.begin(), v.begin() + half, 2);
+            for (auto it = v.begin() + half; it != v.end(); ++it)
+            {
+                st.insert(*it);
+            }
+            for (size_t j = 0; j < half; j += 2)
+            {
+                st.erase(v[j]);
+                st.insert(v[j]);
+            }
+            for (size_t j = 0; j < 10; ++j)
+            {
+                Value a;
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                a._start = min(e1, e2);
+                a._end = max(e1, e2);
+                size_t res_list = 0;
+                size_t max_end = 0;
+                for (const auto& r : l)
+                {
+                    if (intersect(r, a))
+                    {
+                        ++res_list;
+                    }
+                    max_end = max(max_end, r._end);
+                }
+                vector< const_ptr_type > res_sharded;
+                st.iintersect(a._start, a._end, back_inserter(res_sharded));
+                bool ok = st.size() == l.size() and res_sharded.size() == res_list
+                    and st.max_end() == max_end;
+                for (size_t k = 0; k < res_sharded.size(); ++k)
+                {
+                    ok = ok and intersect(*res_sharded[k], a)
+                        and (k == 0 or res_sharded[k - 1]->_start <= res_sharded[k]->_start);
+                }
+                if (not ok)
+                {
+                    clog << "wrong sharded intersection with " << a << '\n';
+                    exit(EXIT_FAILURE);
+                }
+            }
+            st.clear();
+            clog << "sharded intersection ok\n";
+        }
+        else if (op == 10)
+        {
+            // shift intervals starting at or after some position, or all of them
+            bool shift_all = drand48() < .5;
+            size_t pos = size_t(drand48() * po.range_max);
+            if (shift_all)
+            {
+                pos = po.range_max;
+                for (const auto& v : l)
+                {
+                    pos = min(pos, v._start);
+                }
+            }
+            // when shifting left, keep shifted intervals after the unshifted ones
+            size_t max_left = pos;
+            for (const auto& v : l)
+            {
+                if (v._start < pos)
+                {
+                    max_left = min(max_left, pos - v._start - 1);
+                }
+            }
+            long delta = drand48() < .5
+                ? long(drand48() * po.range_max / 10)
+                : -long(drand48() * min(max_left, po.range_max / 10));
+            clog << "shifting from " << pos << " by " << delta << '\n';
+            vector< ptr_type > shifted;
+            for (auto& v : l)
+            {
+                if (v._start >= pos)
+                {
+                    end_t.erase(end_t.iterator_to(v));
+                    bt.erase(v);
+                    shifted.push_back(&v);
+                }
+            }
+            for (auto a : shifted)
+            {
+                a->_start = size_t(long(a->_start) + delta);
+                a->_end = size_t(long(a->_end) + delta);
+                end_t.insert(*a);
+                bt.insert(*a);
+            }
+            if (shift_all)
+            {
+                t.implement_shift(delta);
+            }
+            else
+            {
+                t.shift_from(pos, delta);
+            }
+            check_max_ends(t);
+        }
+        else if (op == 11)
+        {
+            // update endpoints of existing element
+            if (l.size() == 0)
+            {
+                continue;
+            }
+            size_t idx = size_t(drand48() * l.size());
+            auto it = l.begin();
+            while (idx > 0)
+            {
+                ++it;
+                --idx;
+            }
+            ptr_type a = &*it;
+            size_t e = size_t(drand48() * po.range_max);
+            end_t.erase(end_t.iterator_to(*a));
+            bt.erase(*a);
+            if (drand48() < .5)
+            {
+                clog << "updating end of: " << *a << " to " << max(e, a->_start) << '\n';
+                t.update_end(t.iterator_to(*a), max(e, a->_start));
+            }
+            else
+            {
+                clog << "updating start of: " << *a << " to " << min(e, a->_end) << '\n';
+                if (&*t.update_start(t.iterator_to(*a), min(e, a->_end)) != a)
+                {
+                    clog << "update start error\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+            end_t.insert(*a);
+            bt.insert(*a);
+            check_max_ends(t);
+        }
+        else if (op == 12)
+        {
+            // split copies of all elements, join them back, and merge random halves
+            vector< Value > v(l.begin(), l.end());
+            size_t key = size_t(drand48() * po.range_max);
+            clog << "splitting tree of size: " << v.size() << " at " << key << '\n';
+            itree_type t2(v.begin(), v.end());
+            itree_type t3;
+            t2.split(key, t3);
+            check_max_ends(t2);
+            check_colors(t2);
+            check_max_ends(t3);
+            check_colors(t3);
+            size_t n_left = size_t(count_if(v.begin(), v.end(), [&] (const Value& e) { return e._start < key; }));
+            if (t2.size() != n_left or t3.size() != v.size() - n_left
+                or size_t(distance(t2.begin(), t2.end())) != n_left
+                or size_t(distance(t3.begin(), t3.end())) != v.size() - n_left
+                or (not t2.empty() and not (t2.rbegin()->_start < key))
+                or (not t3.empty() and t3.begin()->_start < key))
+            {
+                clog << "split error\n";
+                exit(EXIT_FAILURE);
+            }
+            clog << "joining trees of sizes: " << t2.size() << ", " << t3.size() << '\n';
+            t2.join(t3);
+            check_max_ends(t2);
+            check_colors(t2);
+            if (t2.size() != v.size() or not t3.empty() or size_t(distance(t2.begin(), t2.end())) != v.size())
+            {
+                clog << "join error\n";
+                exit(EXIT_FAILURE);
+            }
+            t2.clear();
+            itree_type t4;
+            for (auto& e : v)
+            {
+                if (drand48() < .5)
+                {
+                    t3.insert(e);
+                }
+                else
+                {
+                    t4.insert(e);
+                }
+            }
+            clog << "merging trees of sizes: " << t3.size() << ", " << t4.size() << '\n';
+            t3.union_with(t4);
+            // with itself, join and union do nothing
+            t3.union_with(t3);
+            t3.join(t3);
+            check_max_ends(t3);
+            check_colors(t3);
+            if (t3.size() != v.size() or not t4.empty() or size_t(distance(t3.begin(), t3.end())) != v.size())
+            {
+                clog << "union error\n";
+                exit(EXIT_FAILURE);
+            }
+            if (not t3.empty())
+            {
+                // splitting into a non-empty tree is rejected, and leaves it intact
+                bool thrown = false;
+                try
+                {
+                    t4.split(key, t3);
+                }
+                catch (const invalid_argument&)
+                {
+                    thrown = true;
+                }
+                if (not thrown or t3.size() != v.size() or not t4.empty())
+                {
+                    clog << "split into non-empty tree error\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+            t3.clear();
+        }
+        else if (op == 13)
+        {
+            // overlap join against a tree of new random intervals, of another type
+            size_t n_other = size_t(drand48() * po.max_load);
+            vector< Value > v(n_other);
+            for (auto& e : v)
+            {
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                e._start = min(e1, e2);
+                e._end = max(e1, e2);
+            }
+            clog << "overlap join with tree of size: " << n_other << '\n';
+            stats_itree_type t2(v.begin(), v.end());
+            vector< pair< const Value*, const Value* > > res;
+            bi::overlap_join(t, t2, [&] (const Value& a, const Value& b) {
+                res.push_back(make_pair(&a, &b));
+            });
+            vector< pair< const Value*, const Value* > > res_naive;
+            for (const auto& a : l)
+            {
+                for (const auto& b : v)
+                {
+                    if (intersect(a, b))
+                    {
+                        res_naive.push_back(make_pair(&a, &b));
+                    }
+                }
+            }
+            sort(res.begin(), res.end());
+            sort(res_naive.begin(), res_naive.end());
+            if (res != res_naive)
+            {
+                clog << "overlap join error\n";
+                exit(EXIT_FAILURE);
+            }
+            t2.clear();
+        }
+        else if (op == 14)
+        {
+            // save a snapshot in the mappable format, and query it in place
+            clog << "saving mapped snapshot of tree of size: " << t.size() << '\n';
+            ostringstream oss;
+            auto id_of = [] (const Value& e) { return uint64_t(uintptr_t(&e)); };
+            bi::save_mapped_itree(oss, t.freeze(), id_of);
+            string data = oss.str();
+            vector< uint64_t > buffer((data.size() + 7) / 8);
+            memcpy(buffer.data(), data.data(), data.size());
+            bi::mapped_itree< size_t > m(buffer.data(), data.size());
+            if (m.size() != t.size() or m.max_end() != t.max_end() or not m.check())
+            {
+                clog << "mapped itree error\n";
+                exit(EXIT_FAILURE);
+            }
+            for (int k = 0; k < 10; ++k)
+            {
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                if (e1 > e2)
+                {
+                    swap(e1, e2);
+                }
+                vector< uint64_t > res;
+                m.iintersect(e1, e2, back_inserter(res));
+                vector< uint64_t > res_tree;
+                for (const auto& e : t.iintersect(e1, e2))
+                {
+                    res_tree.push_back(id_of(e));
+                }
+                if (res != res_tree)
+                {
+                    clog << "mapped itree query error\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+            // truncated or corrupted data is rejected
+            try
+            {
+                bi::mapped_itree< size_t > m2(buffer.data(), data.size() - 1);
+                clog << "mapped itree accepted truncated data\n";
+                exit(EXIT_FAILURE);
+            }
+            catch (const runtime_error&) {}
+            buffer[0] ^= 1;
+            try
+            {
+                bi::mapped_itree< size_t > m2(buffer.data(), data.size());
+                clog << "mapped itree accepted bad magic\n";
+                exit(EXIT_FAILURE);
+            }
+            catch (const runtime_error&) {}
+        }
+        else if (op == 15)
+        {
+            // queries sorted by start through a cursor, followed by a few in random order
+            size_t n_queries = size_t(drand48() * 20);
+            vector< pair< size_t, size_t > > queries(n_queries);
+            for (auto& q : queries)
+            {
+                q.first = size_t(drand48() * po.range_max);
+                q.second = q.first + size_t(drand48() * po.range_max / 10);
+            }
+            sort(queries.begin(), queries.begin() + n_queries * 3 / 4);
+            clog << "cursor queries: " << n_queries << '\n';
+            bi::itree_cursor< itree_type > c(t);
+            for (const auto& q : queries)
+            {
+                vector< const Value* > res;
+                c.iintersect(q.first, q.second, back_inserter(res));
+                vector< const Value* > res_tree;
+                for (const auto& e : t.iintersect(q.first, q.second))
+                {
+                    res_tree.push_back(&e);
+                }
+                if (res != res_tree)
+                {
+                    clog << "cursor query error: [" << q.first << "," << q.second << "]\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+        else if (op == 16)
+        {
+            // copies of all elements in an arena, in a compact tree, and copies of
+            // the first half at the end of the arena, in a second one
+            size_t n = l.size();
+            size_t half = n / 2;
+            vector< Compact_Value > arena(n + half);
+            compact_value_traits::node_traits::set_arena(arena.data(), arena.size());
+            size_t i = 0;
+            for (const auto& e : l)
+            {
+                arena[i]._start = e._start;
+                arena[i]._end = e._end;
+                if (i < half)
+                {
+                    arena[n + i]._start = e._start;
+                    arena[n + i]._end = e._end;
+                }
+                ++i;
+            }
+            clog << "compact trees of size: " << n << ", " << half << '\n';
+            compact_itree_type ct1;
+            vector< size_t > perm(n);
+            for (size_t j = 0; j < perm.size(); ++j)
+            {
+                perm[j] = j;
+                swap(perm[j], perm[size_t(drand48() * (j + 1))]);
+            }
+            for (auto j : perm)
+            {
+                ct1.insert(arena[j]);
+            }
+            compact_itree_type ct2(arena.begin() + n, arena.end());
+            for (int k = 0; k < 10; ++k)
+            {
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                if (e1 > e2)
+                {
+                    swap(e1, e2);
+                }
+                vector< pair< size_t, size_t > > res1;
+                for (const auto& e : ct1.iintersect(e1, e2))
+                {
+                    res1.push_back(make_pair(e._start, e._end));
+                }
+                vector< pair< size_t, size_t > > res2;
+                for (const auto& e : ct2.iintersect(e1, e2))
+                {
+                    res2.push_back(make_pair(e._start, e._end));
+                }
+                vector< pair< size_t, size_t > > res1_naive;
+                vector< pair< size_t, size_t > > res2_naive;
+                for (size_t j = 0; j < n; ++j)
+                {
+                    if (arena[j]._start <= e2 and e1 <= arena[j]._end)
+                    {
+                        res1_naive.push_back(make_pair(arena[j]._start, arena[j]._end));
+                        if (j < half)
+                        {
+                            res2_naive.push_back(make_pair(arena[j]._start, arena[j]._end));
+                        }
+                    }
+                }
+                sort(res1.begin(), res1.end());
+                sort(res2.begin(), res2.end());
+                sort(res1_naive.begin(), res1_naive.end());
+                sort(res2_naive.begin(), res2_naive.end());
+                if (res1 != res1_naive or res2 != res2_naive
+                    or ct1.max_end() != (n == 0 ? 0 : max_element(arena.begin(), arena.begin() + n,
+                        [] (const Compact_Value& lhs, const Compact_Value& rhs) { return lhs._end < rhs._end; })->_end))
+                {
+                    clog << "compact itree query error\n";
+                    exit(EXIT_FAILURE);
+                }
+            }
+            // erase half of the elements again
+            for (size_t j = 0; j < half; ++j)
+            {
+                ct1.erase(ct1.iterator_to(arena[perm[j]]));
+            }
+            if (ct1.size() != n - half or size_t(distance(ct1.begin(), ct1.end())) != ct1.size())
+            {
+                clog << "compact itree erase error\n";
+                exit(EXIT_FAILURE);
+            }
+            // swapped trees keep linking to their own headers
+            ct1.swap(ct2);
+            while (not ct1.empty())
+            {
+                ct1.erase(ct1.begin());
+            }
+            if (half > 0)
+            {
+                ct2.insert(arena[n]);
+            }
+            if (size_t(distance(ct2.begin(), ct2.end())) != n - half + (half > 0 ? 1 : 0)
+                or size_t(distance(ct2.rbegin(), ct2.rend())) != ct2.size())
+            {
+                clog << "compact itree swap error\n";
+                exit(EXIT_FAILURE);
+            }
+            ct1.clear();
+            ct2.clear();
+            // intervals spanning more than the 32-bit max_end field
+            vector< Compact_Value > big(3 + size_t(drand48() * 20));
+            compact_value_traits::node_traits::set_arena(big.data(), big.size());
+            const size_t span = size_t(1) << 33;
+            big[0]._start = 0;
+            big[0]._end = span;
+            big[1]._start = 1;
+            big[1]._end = 2;
+            big[2]._start = 2;
+            big[2]._end = 3;
+            for (size_t j = 3; j < big.size(); ++j)
+            {
+                big[j]._start = size_t(drand48() * span);
+                big[j]._end = big[j]._start + size_t(drand48() * (drand48() < .5 ? span : 10));
+            }
+            compact_itree_type ct3;
+            for (auto& e : big)
+            {
+                ct3.insert(e);
+            }
+            for (int k = 0; k < 10; ++k)
+            {
+                size_t p = (k == 0 ? (size_t(1) << 32) + 5 : size_t(drand48() * 2 * span));
+                size_t n_res = size_t(distance(ct3.iintersect(p, p).begin(), ct3.iintersect(p, p).end()));
+                size_t n_naive = size_t(count_if(big.begin(), big.end(),
+                    [&] (const Compact_Value& e) { return e._start <= p and p <= e._end; }));
+                if (n_res != n_naive)
+                {
+                    clog << "compact itree large span error: p=" << p << '\n';
+                    exit(EXIT_FAILURE);
+                }
+            }
+            ct3.clear();
+            // header slots are freed with their trees: rounds of trees at
+            // distinct addresses would run out of slots otherwise
+            const size_t n_trees = compact_value_traits::node_traits::max_trees * 3 / 4;
+            typedef aligned_storage< sizeof(compact_itree_type), alignof(compact_itree_type) >::type tree_storage;
+            vector< tree_storage > trees(3 * n_trees);
+            for (size_t round = 0; round < 3; ++round)
+            {
+                for (size_t k = 0; k < n_trees; ++k)
+                {
+                    auto tp = new (&trees[round * n_trees + k]) compact_itree_type();
+                    tp->insert(big[k % big.size()]);
+                    tp->clear();
+                }
+                for (size_t k = 0; k < n_trees; ++k)
+                {
+                    reinterpret_cast< compact_itree_type* >(&trees[round * n_trees + k])->~compact_itree_type();
+                }
+            }
+        }
+        else if (op == 17)
+        {
+            // copies of all elements in a pooled tree, erase some, clone, clear and refill
+            clog << "pooled tree of size: " << l.size() << '\n';
+            bi::pooled_itree< itree_type > pt(size_t(1 + drand48() * 16));
+            for (int round = 0; round < 2; ++round)
+            {
+                vector< pair< size_t, size_t > > kept;
+                for (const auto& e : l)
+                {
+                    auto it = pt.emplace(e);
+                    if (drand48() < .3)
+                    {
+                        pt.erase(it);
+                    }
+                    else
+                    {
+                        kept.push_back(make_pair(e._start, e._end));
+                    }
+                }
+                bi::pooled_itree< itree_type > pt2;
+                pt2.clone_from(pt);
+                check_max_ends(pt.tree());
+                check_max_ends(pt2.tree());
+                sort(kept.begin(), kept.end());
+                vector< pair< size_t, size_t > > res;
+                for (const auto& e : pt2)
+                {
+                    res.push_back(make_pair(e._start, e._end));
+                }
+                sort(res.begin(), res.end());
+                bool contiguous = true;
+                for (auto it = pt2.begin(); it != pt2.end() and next(it) != pt2.end(); ++it)
+                {
+                    contiguous = contiguous and &*next(it) == &*it + 1;
+                }
+                if (pt.size() != kept.size() or res != kept or not contiguous)
+                {
+                    clog << "pooled itree error\n";
+                    exit(EXIT_FAILURE);
+                }
+                pt.clear();
+            }
+        }
+        else if (op == 18)
+        {
+            // next_after, prev_before and nearest queries
+            size_t p = size_t(drand48() * po.range_max);
+            size_t k = size_t(drand48() * 10);
+            clog << "nearest: p=" << p << " k=" << k << '\n';
+            auto dist = [&] (const Value& v) {
+                return (v._end < p ? p - v._end : p < v._start ? v._start - p : 0);
+            };
+            const_ptr_type naive_next = nullptr;
+            bool has_before = false;
+            size_t naive_prev_end = 0;
+            vector< size_t > naive_dists;
+            for (const auto& e : t)
+            {
+                if (not naive_next and p < e._start)
+                {
+                    naive_next = &e;
+                }
+                if (e._end < p and (not has_before or naive_prev_end < e._end))
+                {
+                    has_before = true;
+                    naive_prev_end = e._end;
+                }
+                naive_dists.push_back(dist(e));
+            }
+            sort(naive_dists.begin(), naive_dists.end());
+            naive_dists.resize(min(k, naive_dists.size()));
+            auto next_it = t.next_after(p);
+            auto prev_it = t.prev_before(p);
+            vector< const_ptr_type > res;
+            t.nearest(p, k, back_inserter(res));
+            vector< size_t > res_dists;
+            for (auto v : res)
+            {
+                res_dists.push_back(dist(*v));
+            }
+            vector< const_ptr_type > res_sorted(res);
+            sort(res_sorted.begin(), res_sorted.end());
+            if ((next_it == t.end() ? nullptr : &*next_it) != naive_next
+                or (prev_it == t.end()) == has_before
+                or (has_before and prev_it->_end != naive_prev_end)
+                or res_dists != naive_dists
+                or unique(res_sorted.begin(), res_sorted.end()) != res_sorted.end())
+            {
+                clog << "nearest error\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (op == 19)
+        {
+            // containing and contained-in queries, with and without subtree min_end
+            size_t e1 = size_t(drand48() * po.range_max);
+            size_t e2 = size_t(drand48() * po.range_max);
+            size_t q_start = min(e1, e2);
+            size_t q_end = max(e1, e2);
+            clog << "containment: [" << q_start << "," << q_end << "]\n";
+            vector< const_ptr_type > naive_containing;
+            vector< const_ptr_type > naive_contained_in;
+            vector< const_ptr_type > naive_end_containing;
+            vector< const_ptr_type > naive_end_contained_in;
+            for (const auto& e : l)
+            {
+                if (e._start <= q_start and q_end <= e._end)
+                {
+                    naive_containing.push_back(&e);
+                }
+                if (q_start <= e._start and e._end <= q_end)
+                {
+                    naive_contained_in.push_back(&e);
+                }
+                // end_t holds the intervals [e._end, e._end]
+                if (q_start == e._end and q_end == e._end)
+                {
+                    naive_end_containing.push_back(&e);
+                }
+                if (q_start <= e._end and e._end <= q_end)
+                {
+                    naive_end_contained_in.push_back(&e);
+                }
+            }
+            auto get_sorted = [] (vector< const_ptr_type > v) {
+                sort(v.begin(), v.end());
+                return v;
+            };
+            vector< const_ptr_type > res_containing;
+            for (const auto& e : t.icontaining(q_start, q_end))
+            {
+                res_containing.push_back(&e);
+            }
+            vector< const_ptr_type > res_contained_in;
+            for (const auto& e : t.icontained_in(q_start, q_end))
+            {
+                res_contained_in.push_back(&e);
+            }
+            vector< const_ptr_type > res_end_containing;
+            for (const auto& e : end_t.icontaining(q_start, q_end))
+            {
+                res_end_containing.push_back(&e);
+            }
+            vector< const_ptr_type > res_end_contained_in;
+            for (const auto& e : end_t.icontained_in(q_start, q_end))
+            {
+                res_end_contained_in.push_back(&e);
+            }
+            auto by_start = [] (const_ptr_type lhs, const_ptr_type rhs) { return lhs->_start < rhs->_start; };
+            if (get_sorted(res_containing) != get_sorted(naive_containing)
+                or get_sorted(res_contained_in) != get_sorted(naive_contained_in)
+                or get_sorted(res_end_containing) != get_sorted(naive_end_containing)
+                or get_sorted(res_end_contained_in) != get_sorted(naive_end_contained_in)
+                or not is_sorted(res_containing.begin(), res_containing.end(), by_start)
+                or not is_sorted(res_contained_in.begin(), res_contained_in.end(), by_start))
+            {
+                clog << "containment error\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (op == 20)
+        {
+            // aggregates of copies of all elements, through updates, split and join
+            vector< Value > v(l.begin(), l.end());
+            clog << "augmented tree of size: " << v.size() << '\n';
+            augmented_itree_type at;
+            augmented_itree_type at2;
+            size_t half = v.size() / 2;
+            for (size_t j = 0; j < half; ++j)
+            {
+                at.insert(v[j]);
+            }
+            at.bulk_load(v.begin() + half, v.end());
+            check_augmented(at, po.range_max);
+            vector< bool > linked(v.size(), true);
+            for (size_t j = 0; j < v.size() / 4; ++j)
+            {
+                size_t k = size_t(drand48() * v.size());
+                if (not linked[k])
+                {
+                    continue;
+                }
+                double r = drand48();
+                if (r < .3)
+                {
+                    at.erase(at.iterator_to(v[k]));
+                    linked[k] = false;
+                }
+                else if (r < .6)
+                {
+                    at.update_end(at.iterator_to(v[k]), v[k]._start + size_t(drand48() * po.range_max / 4));
+                }
+                else
+                {
+                    at.update_start(at.iterator_to(v[k]), size_t(drand48() * (v[k]._end + 1)));
+                }
+            }
+            check_augmented(at, po.range_max);
+            size_t key = size_t(drand48() * po.range_max);
+            at.split(key, at2);
+            check_augmented(at, po.range_max);
+            check_augmented(at2, po.range_max);
+            at.join(at2);
+            check_augmented(at, po.range_max);
+            at.clear();
+        }
+        else if (op == 21)
+        {
+            // persistent tree: random inserts and erases, keeping snapshots, then check every version
+            clog << "persistent tree of size: " << l.size() << '\n';
+            typedef bi::persistent_itree< ITree_Value_Traits< Value > > persistent_itree_type;
+            vector< const_ptr_type > v;
+            for (const auto& e : l)
+            {
+                v.push_back(&e);
+            }
+            for (size_t j = v.size(); j > 1; --j)
+            {
+                swap(v[j - 1], v[size_t(drand48() * j)]);
+            }
+            vector< persistent_itree_type > versions;
+            vector< vector< const_ptr_type > > expected;
+            persistent_itree_type pt;
+            vector< const_ptr_type > cur;
+            size_t next_v = 0;
+            while (next_v < v.size() or not cur.empty())
+            {
+                if (next_v < v.size() and (cur.empty() or drand48() < .7))
+                {
+                    pt.insert(*v[next_v]);
+                    cur.push_back(v[next_v++]);
+                }
+                else
+                {
+                    size_t k = size_t(drand48() * cur.size());
+                    if (not pt.erase(*cur[k]))
+                    {
+                        clog << "persistent itree erase error\n";
+                        exit(EXIT_FAILURE);
+                    }
+                    cur.erase(cur.begin() + k);
+                }
+                if (drand48() < .1)
+                {
+                    versions.push_back(pt.snapshot());
+                    expected.push_back(cur);
+                }
+            }
+            versions.push_back(pt);
+            expected.push_back(cur);
+            if (not v.empty() and pt.erase(*v[0]))
+            {
+                clog << "persistent itree erased absent element\n";
+                exit(EXIT_FAILURE);
+            }
+            for (size_t j = 0; j < versions.size(); ++j)
+            {
+                const auto& pv = versions[j];
+                if (not pv.check() or pv.size() != expected[j].size())
+                {
+                    clog << "persistent itree check error\n";
+                    exit(EXIT_FAILURE);
+                }
+                for (int q = 0; q < 3; ++q)
+                {
+                    size_t e1 = size_t(drand48() * po.range_max);
+                    size_t e2 = size_t(drand48() * po.range_max);
+                    Value qv;
+                    qv._start = min(e1, e2);
+                    qv._end = max(e1, e2);
+                    vector< const_ptr_type > res;
+                    pv.iintersect(qv._start, qv._end, back_inserter(res));
+                    vector< const_ptr_type > naive;
+                    for (auto p : expected[j])
+                    {
+                        if (intersect(*p, qv))
+                        {
+                            naive.push_back(p);
+                        }
+                    }
+                    sort(res.begin(), res.end());
+                    sort(naive.begin(), naive.end());
+                    if (res != naive)
+                    {
+                        clog << "persistent itree iintersect error\n";
+                        exit(EXIT_FAILURE);
+                    }
+                }
+            }
+        }
+        else if (op == 22)
+        {
+            // copies of all elements in a counting tree: updates keep the end index in sync
+            clog << "counting tree of size: " << l.size() << '\n';
+            vector< Value > v(l.begin(), l.end());
+            size_t half = v.size() / 2;
+            bi::counting_itree< itree_type, end_itree_type > ct(v.begin(), v.begin() + half);
+            for (size_t j = half; j < v.size(); ++j)
+            {
+                ct.insert(v[j]);
+            }
+            vector< bool > linked(v.size(), true);
+            for (size_t j = 0; j < v.size(); ++j)
+            {
+                double r = drand48();
+                if (r < .25)
+                {
+                    ct.erase(ct.iterator_to(v[j]));
+                    linked[j] = false;
+                }
+                else if (r < .5)
+                {
+                    ct.update_end(ct.iterator_to(v[j]), v[j]._start + size_t(drand48() * po.range_max / 10));
+                }
+                else if (r < .75)
+                {
+                    ct.update_start(ct.iterator_to(v[j]), size_t(drand48() * (v[j]._end + 1)));
+                }
+            }
+            for (int k = 0; k < 10; ++k)
+            {
+                Value a;
+                size_t e1 = size_t(drand48() * po.range_max);
+                size_t e2 = size_t(drand48() * po.range_max);
+                a._start = min(e1, e2);
+                a._end = max(e1, e2);
+                size_t n_naive = 0;
+                for (size_t j = 0; j < v.size(); ++j)
+                {
+                    n_naive += (linked[j] and intersect(v[j], a));
+                }
+                if (ct.iintersect_count(a._start, a._end) != n_naive
+                    or ct.end_index().size() != ct.size())
+                {
+                    clog << "wrong counting tree intersection count with " << a << '\n';
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
         if (po.print_tree_each_op)
         {
             print_tree(t);
@@ -377,8 +2050,15 @@ void real_main(const Program_Options& po)
         ptr_type a = &*it;
         l.erase(it);
         t.erase(t.iterator_to(*a));
+        end_t.erase(end_t.iterator_to(*a));
+        bt.erase(*a);
         delete a;
     }
+    if (not bt.empty())
+    {
+        clog << "btree not empty\n";
+        exit(EXIT_FAILURE);
+    }
     clog << "----- success\n";
 }
 
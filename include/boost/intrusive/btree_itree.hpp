@@ -0,0 +1,596 @@
+#ifndef __BTREE_ITREE_HPP
+#define __BTREE_ITREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+namespace boost
+{
+namespace intrusive
+{
+namespace detail
+{
+
+/** Scan of a block of intervals stored in structure-of-arrays form.
+ *
+ * Computes the bitmask of the positions j < n such that
+ * starts[j] <= int_end and int_start <= ends[j]. The arrays must be readable
+ * up to n rounded up to a multiple of 8. The generic version is scalar;
+ * 4- and 8-byte integral keys use SSE/AVX2 comparisons when available.
+ */
+template < typename Key_Type, std::size_t key_size = sizeof(Key_Type), bool is_integral = std::is_integral< Key_Type >::value >
+struct Block_Scan
+{
+    static std::uint64_t scan(const Key_Type* starts, const Key_Type* ends, std::size_t n,
+                              const Key_Type& int_start, const Key_Type& int_end)
+    {
+        std::uint64_t mask = 0;
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            mask |= std::uint64_t(not (ends[j] < int_start) and not (int_end < starts[j])) << j;
+        }
+        return mask;
+    }
+}; // struct Block_Scan
+
+inline std::uint64_t low_bits_mask(std::size_t n)
+{
+    return n < 64 ? (std::uint64_t(1) << n) - 1 : ~std::uint64_t(0);
+}
+
+#if defined(__AVX2__)
+
+template < typename Key_Type >
+struct Block_Scan< Key_Type, 8, true >
+{
+    static std::uint64_t scan(const Key_Type* starts, const Key_Type* ends, std::size_t n,
+                              const Key_Type& int_start, const Key_Type& int_end)
+    {
+        // signed comparisons; unsigned keys are biased by the sign bit
+        const __m256i bias = _mm256_set1_epi64x(std::is_signed< Key_Type >::value ? 0 : INT64_MIN);
+        const __m256i v_start = _mm256_xor_si256(_mm256_set1_epi64x(std::int64_t(int_start)), bias);
+        const __m256i v_end = _mm256_xor_si256(_mm256_set1_epi64x(std::int64_t(int_end)), bias);
+        std::uint64_t mask = 0;
+        for (std::size_t j = 0; j < n; j += 4)
+        {
+            __m256i s = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast< const __m256i* >(starts + j)), bias);
+            __m256i e = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast< const __m256i* >(ends + j)), bias);
+            __m256i miss = _mm256_or_si256(_mm256_cmpgt_epi64(v_start, e), _mm256_cmpgt_epi64(s, v_end));
+            mask |= std::uint64_t(~_mm256_movemask_pd(_mm256_castsi256_pd(miss)) & 0xF) << j;
+        }
+        return mask & low_bits_mask(n);
+    }
+}; // struct Block_Scan
+
+template < typename Key_Type >
+struct Block_Scan< Key_Type, 4, true >
+{
+    static std::uint64_t scan(const Key_Type* starts, const Key_Type* ends, std::size_t n,
+                              const Key_Type& int_start, const Key_Type& int_end)
+    {
+        const __m256i bias = _mm256_set1_epi32(std::is_signed< Key_Type >::value ? 0 : INT32_MIN);
+        const __m256i v_start = _mm256_xor_si256(_mm256_set1_epi32(std::int32_t(int_start)), bias);
+        const __m256i v_end = _mm256_xor_si256(_mm256_set1_epi32(std::int32_t(int_end)), bias);
+        std::uint64_t mask = 0;
+        for (std::size_t j = 0; j < n; j += 8)
+        {
+            __m256i s = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast< const __m256i* >(starts + j)), bias);
+            __m256i e = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast< const __m256i* >(ends + j)), bias);
+            __m256i miss = _mm256_or_si256(_mm256_cmpgt_epi32(v_start, e), _mm256_cmpgt_epi32(s, v_end));
+            mask |= std::uint64_t(~_mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xFF) << j;
+        }
+        return mask & low_bits_mask(n);
+    }
+}; // struct Block_Scan
+
+#elif defined(__SSE2__)
+
+#if defined(__SSE4_2__)
+template < typename Key_Type >
+struct Block_Scan< Key_Type, 8, true >
+{
+    static std::uint64_t scan(const Key_Type* starts, const Key_Type* ends, std::size_t n,
+                              const Key_Type& int_start, const Key_Type& int_end)
+    {
+        const __m128i bias = _mm_set1_epi64x(std::is_signed< Key_Type >::value ? 0 : INT64_MIN);
+        const __m128i v_start = _mm_xor_si128(_mm_set1_epi64x(std::int64_t(int_start)), bias);
+        const __m128i v_end = _mm_xor_si128(_mm_set1_epi64x(std::int64_t(int_end)), bias);
+        std::uint64_t mask = 0;
+        for (std::size_t j = 0; j < n; j += 2)
+        {
+            __m128i s = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast< const __m128i* >(starts + j)), bias);
+            __m128i e = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast< const __m128i* >(ends + j)), bias);
+            __m128i miss = _mm_or_si128(_mm_cmpgt_epi64(v_start, e), _mm_cmpgt_epi64(s, v_end));
+            mask |= std::uint64_t(~_mm_movemask_pd(_mm_castsi128_pd(miss)) & 0x3) << j;
+        }
+        return mask & low_bits_mask(n);
+    }
+}; // struct Block_Scan
+#endif
+
+template < typename Key_Type >
+struct Block_Scan< Key_Type, 4, true >
+{
+    static std::uint64_t scan(const Key_Type* starts, const Key_Type* ends, std::size_t n,
+                              const Key_Type& int_start, const Key_Type& int_end)
+    {
+        const __m128i bias = _mm_set1_epi32(std::is_signed< Key_Type >::value ? 0 : INT32_MIN);
+        const __m128i v_start = _mm_xor_si128(_mm_set1_epi32(std::int32_t(int_start)), bias);
+        const __m128i v_end = _mm_xor_si128(_mm_set1_epi32(std::int32_t(int_end)), bias);
+        std::uint64_t mask = 0;
+        for (std::size_t j = 0; j < n; j += 4)
+        {
+            __m128i s = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast< const __m128i* >(starts + j)), bias);
+            __m128i e = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast< const __m128i* >(ends + j)), bias);
+            __m128i miss = _mm_or_si128(_mm_cmpgt_epi32(v_start, e), _mm_cmpgt_epi32(s, v_end));
+            mask |= std::uint64_t(~_mm_movemask_ps(_mm_castsi128_ps(miss)) & 0xF) << j;
+        }
+        return mask & low_bits_mask(n);
+    }
+}; // struct Block_Scan
+
+#endif
+
+} // namespace detail
+
+/** High-fanout interval index.
+ *
+ * A B+tree keyed by interval start. Leaves hold up to Leaf_Size intervals as
+ * arrays of starts, ends and pointers to the elements; internal nodes hold,
+ * for each of up to Fanout children, the minimum start and the maximum end in
+ * the child, so that whole subtrees can be pruned. Both kinds of nodes are
+ * scanned with vectorized comparisons (see detail::Block_Scan). One lookup
+ * touches O(log_B n) nodes instead of O(log n).
+ *
+ * Unlike itree, the index is not intrusive: it owns its nodes, and refers to
+ * the elements through the Value Traits, which must provide key_type,
+ * get_start() and get_end(), as for itree. Nodes that become less than a
+ * quarter full after erasure are merged with a neighbour when they fit.
+ */
+template < typename Value_Traits, std::size_t Leaf_Size = 32, std::size_t Fanout = 32 >
+class btree_itree
+{
+    static_assert(Leaf_Size % 8 == 0 and Leaf_Size <= 64, "Leaf_Size must be a multiple of 8, at most 64");
+    static_assert(Fanout % 8 == 0 and Fanout <= 64, "Fanout must be a multiple of 8, at most 64");
+public:
+    typedef typename Value_Traits::value_type value_type;
+    typedef typename Value_Traits::key_type key_type;
+    typedef typename Value_Traits::const_pointer const_pointer;
+    typedef typename Value_Traits::const_reference const_reference;
+    typedef std::size_t size_type;
+
+    // disallow copy
+    btree_itree(const btree_itree&) = delete;
+    btree_itree& operator = (const btree_itree&) = delete;
+
+    btree_itree() : _root(nullptr), _height(0), _size(0) {}
+
+    template < class Iterator >
+    btree_itree(Iterator b, Iterator e) : btree_itree()
+    {
+        for (; b != e; ++b)
+        {
+            insert(*b);
+        }
+    }
+
+    btree_itree(btree_itree&& other) : _root(other._root), _height(other._height), _size(other._size)
+    {
+        other._root = nullptr;
+        other._height = 0;
+        other._size = 0;
+    }
+
+    btree_itree& operator = (btree_itree&& other)
+    {
+        std::swap(_root, other._root);
+        std::swap(_height, other._height);
+        std::swap(_size, other._size);
+        return *this;
+    }
+
+    ~btree_itree() { clear(); }
+
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /** Insert an element. Elements with equal starts keep insertion order. */
+    void insert(const_reference v)
+    {
+        const_pointer p = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(v));
+        if (not _root)
+        {
+            _root = new Leaf();
+            _height = 0;
+        }
+        Node* sibling = insert_rec(_root, _height, Value_Traits::get_start(p), Value_Traits::get_end(p), p);
+        if (sibling)
+        {
+            Inner* new_root = new Inner();
+            new_root->n = 0;
+            append_child(new_root, _root, _height);
+            append_child(new_root, sibling, _height);
+            _root = new_root;
+            ++_height;
+        }
+        ++_size;
+    }
+
+    /** Erase an element, identified by its address.
+     * @return True iff the element was found.
+     */
+    bool erase(const_reference v)
+    {
+        const_pointer p = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(v));
+        if (not _root or not erase_rec(_root, _height, Value_Traits::get_start(p), p))
+        {
+            return false;
+        }
+        --_size;
+        while (_height > 0 and _root->n == 1)
+        {
+            Node* child = static_cast< Inner* >(_root)->children[0];
+            delete static_cast< Inner* >(_root);
+            _root = child;
+            --_height;
+        }
+        if (_root->n == 0)
+        {
+            clear();
+        }
+        return true;
+    }
+
+    /** Remove all elements (the elements themselves are not modified). */
+    void clear()
+    {
+        if (_root)
+        {
+            dispose(_root, _height);
+        }
+        _root = nullptr;
+        _height = 0;
+        _size = 0;
+    }
+
+    /** Get maximum right endpoint in the index. */
+    key_type max_end() const
+    {
+        key_type min_start;
+        key_type max_end;
+        if (not _root)
+        {
+            return key_type();
+        }
+        summarize(_root, _height, min_start, max_end);
+        return max_end;
+    }
+
+    /** Visit intervals that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(value) in start order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        return not _root or for_each_rec(_root, _height, int_start, int_end, visitor);
+    }
+
+    /** Return intervals that intersect a given interval.
+     * @param out Output iterator receiving element pointers, in start order.
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(const key_type& int_start, const key_type& int_end, Output_Iterator out) const
+    {
+        for_each_intersection(int_start, int_end, [&] (const value_type& v) {
+            *out++ = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(v));
+            return true;
+        });
+        return out;
+    }
+
+private:
+    typedef detail::Block_Scan< key_type > block_scan;
+
+    struct Node
+    {
+        std::size_t n;
+    };
+    struct Leaf : public Node
+    {
+        Leaf() : starts(), ends(), values() { this->n = 0; }
+        key_type starts[Leaf_Size];
+        key_type ends[Leaf_Size];
+        const_pointer values[Leaf_Size];
+    };
+    struct Inner : public Node
+    {
+        Inner() : min_starts(), max_ends(), children() { this->n = 0; }
+        key_type min_starts[Fanout];
+        key_type max_ends[Fanout];
+        Node* children[Fanout];
+    };
+
+    static void summarize(const Node* node, std::size_t height, key_type& min_start, key_type& max_end)
+    {
+        if (height == 0)
+        {
+            const Leaf* leaf = static_cast< const Leaf* >(node);
+            min_start = leaf->starts[0];
+            max_end = *std::max_element(leaf->ends, leaf->ends + leaf->n);
+        }
+        else
+        {
+            const Inner* inner = static_cast< const Inner* >(node);
+            min_start = inner->min_starts[0];
+            max_end = *std::max_element(inner->max_ends, inner->max_ends + inner->n);
+        }
+    }
+
+    static void refresh_child(Inner* inner, std::size_t i, std::size_t child_height)
+    {
+        summarize(inner->children[i], child_height, inner->min_starts[i], inner->max_ends[i]);
+    }
+
+    static void append_child(Inner* inner, Node* child, std::size_t child_height)
+    {
+        inner->children[inner->n] = child;
+        refresh_child(inner, inner->n, child_height);
+        ++inner->n;
+    }
+
+    // move entries [from, n) of src to the end of dest
+    static void move_entries(Node* dest, Node* src, std::size_t from, std::size_t height)
+    {
+        if (height == 0)
+        {
+            Leaf* d = static_cast< Leaf* >(dest);
+            Leaf* s = static_cast< Leaf* >(src);
+            std::copy(s->starts + from, s->starts + s->n, d->starts + d->n);
+            std::copy(s->ends + from, s->ends + s->n, d->ends + d->n);
+            std::copy(s->values + from, s->values + s->n, d->values + d->n);
+        }
+        else
+        {
+            Inner* d = static_cast< Inner* >(dest);
+            Inner* s = static_cast< Inner* >(src);
+            std::copy(s->min_starts + from, s->min_starts + s->n, d->min_starts + d->n);
+            std::copy(s->max_ends + from, s->max_ends + s->n, d->max_ends + d->n);
+            std::copy(s->children + from, s->children + s->n, d->children + d->n);
+        }
+        dest->n += src->n - from;
+        src->n = from;
+    }
+
+    static Node* new_node(std::size_t height)
+    {
+        return height == 0 ? static_cast< Node* >(new Leaf()) : static_cast< Node* >(new Inner());
+    }
+
+    static void delete_node(Node* node, std::size_t height)
+    {
+        if (height == 0)
+        {
+            delete static_cast< Leaf* >(node);
+        }
+        else
+        {
+            delete static_cast< Inner* >(node);
+        }
+    }
+
+    static void dispose(Node* node, std::size_t height)
+    {
+        if (height > 0)
+        {
+            Inner* inner = static_cast< Inner* >(node);
+            for (std::size_t i = 0; i < inner->n; ++i)
+            {
+                dispose(inner->children[i], height - 1);
+            }
+        }
+        delete_node(node, height);
+    }
+
+    // index of the child where a new interval with the given start goes
+    static std::size_t route(const Inner* inner, const key_type& start)
+    {
+        std::size_t i = std::upper_bound(inner->min_starts, inner->min_starts + inner->n, start) - inner->min_starts;
+        return i > 0 ? i - 1 : 0;
+    }
+
+    // returns the new right sibling if node was split
+    static Node* insert_rec(Node* node, std::size_t height,
+                            const key_type& start, const key_type& end, const_pointer p)
+    {
+        if (height == 0)
+        {
+            Leaf* leaf = static_cast< Leaf* >(node);
+            Leaf* sibling = nullptr;
+            std::size_t pos = std::upper_bound(leaf->starts, leaf->starts + leaf->n, start) - leaf->starts;
+            if (leaf->n == Leaf_Size)
+            {
+                sibling = new Leaf();
+                move_entries(sibling, leaf, Leaf_Size / 2, 0);
+                if (pos > leaf->n)
+                {
+                    pos -= leaf->n;
+                    leaf = sibling;
+                }
+            }
+            std::copy_backward(leaf->starts + pos, leaf->starts + leaf->n, leaf->starts + leaf->n + 1);
+            std::copy_backward(leaf->ends + pos, leaf->ends + leaf->n, leaf->ends + leaf->n + 1);
+            std::copy_backward(leaf->values + pos, leaf->values + leaf->n, leaf->values + leaf->n + 1);
+            leaf->starts[pos] = start;
+            leaf->ends[pos] = end;
+            leaf->values[pos] = p;
+            ++leaf->n;
+            return sibling;
+        }
+        Inner* inner = static_cast< Inner* >(node);
+        std::size_t i = route(inner, start);
+        Node* child_sibling = insert_rec(inner->children[i], height - 1, start, end, p);
+        refresh_child(inner, i, height - 1);
+        if (not child_sibling)
+        {
+            return nullptr;
+        }
+        Inner* sibling = nullptr;
+        std::size_t pos = i + 1;
+        if (inner->n == Fanout)
+        {
+            sibling = new Inner();
+            move_entries(sibling, inner, Fanout / 2, height);
+            if (pos > inner->n)
+            {
+                pos -= inner->n;
+                inner = sibling;
+            }
+        }
+        std::copy_backward(inner->min_starts + pos, inner->min_starts + inner->n, inner->min_starts + inner->n + 1);
+        std::copy_backward(inner->max_ends + pos, inner->max_ends + inner->n, inner->max_ends + inner->n + 1);
+        std::copy_backward(inner->children + pos, inner->children + inner->n, inner->children + inner->n + 1);
+        inner->children[pos] = child_sibling;
+        refresh_child(inner, pos, height - 1);
+        ++inner->n;
+        return sibling;
+    }
+
+    static void remove_child(Inner* inner, std::size_t i)
+    {
+        std::copy(inner->min_starts + i + 1, inner->min_starts + inner->n, inner->min_starts + i);
+        std::copy(inner->max_ends + i + 1, inner->max_ends + inner->n, inner->max_ends + i);
+        std::copy(inner->children + i + 1, inner->children + inner->n, inner->children + i);
+        --inner->n;
+    }
+
+    // after an erase in child i: drop it if empty, merge it with a neighbour if underfull
+    static void fix_child(Inner* inner, std::size_t i, std::size_t child_height)
+    {
+        Node* child = inner->children[i];
+        std::size_t capacity = child_height == 0 ? Leaf_Size : Fanout;
+        if (child->n == 0)
+        {
+            delete_node(child, child_height);
+            remove_child(inner, i);
+            return;
+        }
+        refresh_child(inner, i, child_height);
+        if (child->n >= capacity / 4)
+        {
+            return;
+        }
+        std::size_t left;
+        if (i + 1 < inner->n and child->n + inner->children[i + 1]->n <= capacity)
+        {
+            left = i;
+        }
+        else if (i > 0 and inner->children[i - 1]->n + child->n <= capacity)
+        {
+            left = i - 1;
+        }
+        else
+        {
+            return;
+        }
+        move_entries(inner->children[left], inner->children[left + 1], 0, child_height);
+        delete_node(inner->children[left + 1], child_height);
+        remove_child(inner, left + 1);
+        refresh_child(inner, left, child_height);
+    }
+
+    static bool erase_rec(Node* node, std::size_t height, const key_type& start, const_pointer p)
+    {
+        if (height == 0)
+        {
+            Leaf* leaf = static_cast< Leaf* >(node);
+            for (std::size_t j = std::lower_bound(leaf->starts, leaf->starts + leaf->n, start) - leaf->starts;
+                 j < leaf->n and not (start < leaf->starts[j]); ++j)
+            {
+                if (leaf->values[j] == p)
+                {
+                    std::copy(leaf->starts + j + 1, leaf->starts + leaf->n, leaf->starts + j);
+                    std::copy(leaf->ends + j + 1, leaf->ends + leaf->n, leaf->ends + j);
+                    std::copy(leaf->values + j + 1, leaf->values + leaf->n, leaf->values + j);
+                    --leaf->n;
+                    return true;
+                }
+            }
+            return false;
+        }
+        // equal starts can span several children
+        Inner* inner = static_cast< Inner* >(node);
+        std::size_t i = std::lower_bound(inner->min_starts, inner->min_starts + inner->n, start) - inner->min_starts;
+        for (i = (i > 0 ? i - 1 : 0); i < inner->n and not (start < inner->min_starts[i]); ++i)
+        {
+            if (erase_rec(inner->children[i], height - 1, start, p))
+            {
+                fix_child(inner, i, height - 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template < class Visitor >
+    static bool for_each_rec(const Node* node, std::size_t height,
+                             const key_type& int_start, const key_type& int_end, Visitor& visitor)
+    {
+        if (height == 0)
+        {
+            const Leaf* leaf = static_cast< const Leaf* >(node);
+            std::uint64_t mask = block_scan::scan(leaf->starts, leaf->ends, leaf->n, int_start, int_end);
+            for (; mask; mask &= mask - 1)
+            {
+                if (not visitor(*leaf->values[count_trailing_zeros(mask)]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        const Inner* inner = static_cast< const Inner* >(node);
+        std::uint64_t mask = block_scan::scan(inner->min_starts, inner->max_ends, inner->n, int_start, int_end);
+        for (; mask; mask &= mask - 1)
+        {
+            if (not for_each_rec(inner->children[count_trailing_zeros(mask)], height - 1, int_start, int_end, visitor))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::size_t count_trailing_zeros(std::uint64_t mask)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(mask);
+#else
+        std::size_t res = 0;
+        for (; not (mask & 1); mask >>= 1)
+        {
+            ++res;
+        }
+        return res;
+#endif
+    }
+
+    Node* _root;
+    std::size_t _height;
+    size_type _size;
+}; // class btree_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
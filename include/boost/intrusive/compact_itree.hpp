@@ -0,0 +1,327 @@
+#ifndef __COMPACT_ITREE_HPP
+#define __COMPACT_ITREE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <boost/intrusive/link_mode.hpp>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Tree bookkeeping of a compact itree node.
+ *
+ * Values stored in an itree with compact_itree_value_traits derive from this
+ * class. Links are 32-bit indices into a contiguous array of values (see
+ * compact_itree_node_traits), the color is packed in the low bit of the
+ * parent link, and max_end is stored as Max_End_Type. Since the itree stores
+ * max_end of integral keys relative to the end of the node (max_end - end >= 0),
+ * a 32-bit Max_End_Type is exact whenever every subtree spans less than 2^32
+ * past the end of its root, even with 64-bit keys. Larger distances saturate
+ * to the maximum Max_End_Type, which reads back as unbounded: queries stay
+ * correct, but do not prune such subtrees. With 32-bit max_end, the
+ * bookkeeping takes 16 bytes instead of 40 with pointers.
+ *
+ * Non-integral keys, such as floating point ones, are stored as absolute
+ * values, which cannot be narrowed safely: Max_End_Type must then be the key
+ * type itself (see compact_itree_node_traits).
+ */
+template < typename Max_End_Type = std::uint32_t >
+struct compact_itree_node
+{
+    compact_itree_node() : _parent_color(0), _left(0), _right(0), _max_end() {}
+
+    std::uint32_t _parent_color;
+    std::uint32_t _left;
+    std::uint32_t _right;
+    Max_End_Type _max_end;
+}; // struct compact_itree_node
+
+/** Node Traits for itrees of values in a contiguous array, with 32-bit links.
+ *
+ * Node Traits are static, so the array (the arena) is registered once per
+ * (T, Max_End_Type, Tag) combination with set_arena(), before any value is
+ * inserted; it must not move while it holds values linked in a tree. Use
+ * distinct Tag types for independent arenas.
+ *
+ * A link is 0 for null, i + 1 for the value at index i, or refers to the
+ * header of a tree. Headers live inside the tree objects, outside the arena,
+ * so a tree takes one of max_trees header slots, shared by all trees using
+ * these traits, as soon as it is constructed (initializing the header links
+ * it to itself). Slots are looked up by address, so a tree constructed where
+ * a previous one was reuses its slot. The header does not use its max_end
+ * field, which caches the slot index, so that linking to the header takes
+ * O(1) after the first lookup. Trees should be declared as
+ * compact_itree< itree_type >, which frees the slot when the tree is
+ * destroyed; release_header() frees it by hand, and must then be the last
+ * use of the tree.
+ *
+ * With integral keys, Max_End_Type must be integral, and may be narrower than
+ * the key type (see compact_itree_node). With other keys, it must be the key
+ * type.
+ */
+template < typename T, typename Key_Type, typename Max_End_Type = Key_Type, typename Tag = void >
+struct compact_itree_node_traits
+{
+    static_assert(std::is_integral< Key_Type >::value ? std::is_integral< Max_End_Type >::value
+                                                      : std::is_same< Max_End_Type, Key_Type >::value,
+                  "compact_itree_node_traits: Max_End_Type must be integral with integral keys,"
+                  " and the key type otherwise");
+
+    typedef compact_itree_node< Max_End_Type > node;
+    typedef node* node_ptr;
+    typedef const node* const_node_ptr;
+    typedef std::uint32_t color;
+    typedef Key_Type key_type;
+
+    static const std::size_t max_trees = 256;
+    static const std::uint32_t max_nodes = (std::uint32_t(1) << 31) - 1 - max_trees;
+    static_assert(std::numeric_limits< Max_End_Type >::max() >= Max_End_Type(max_trees),
+                  "compact_itree_node_traits: Max_End_Type cannot hold a header slot index");
+
+    /** Register the array holding all values linked with these traits.
+     * @param base Array begin.
+     * @param n Number of values, at most max_nodes.
+     */
+    static void set_arena(T* base, std::size_t n)
+    {
+        if (n > max_nodes)
+        {
+            throw std::length_error("compact_itree_node_traits: arena too large");
+        }
+        arena_base() = base;
+        arena_size() = n;
+    }
+
+    /** Free the header slot of a tree (given by t.end().pointed_node()). */
+    static void release_header(const_node_ptr header)
+    {
+        for (std::size_t i = 0; i < max_trees; ++i)
+        {
+            const_node_ptr expected = header;
+            if (headers()[i].compare_exchange_strong(expected, nullptr))
+            {
+                return;
+            }
+        }
+    }
+
+    static node_ptr get_parent(const_node_ptr n) { return decode(n->_parent_color >> 1); }
+    static void set_parent(node_ptr n, node_ptr p) { n->_parent_color = (encode(p) << 1) | (n->_parent_color & 1); }
+    static node_ptr get_left(const_node_ptr n) { return decode(n->_left); }
+    static void set_left(node_ptr n, node_ptr p) { n->_left = encode(p); }
+    static node_ptr get_right(const_node_ptr n) { return decode(n->_right); }
+    static void set_right(node_ptr n, node_ptr p) { n->_right = encode(p); }
+    static color get_color(const_node_ptr n) { return n->_parent_color & 1; }
+    static void set_color(node_ptr n, color c) { n->_parent_color = (n->_parent_color & ~std::uint32_t(1)) | c; }
+    static color black() { return 0; }
+    static color red() { return 1; }
+    static key_type get_max_end(const_node_ptr n)
+    {
+        return (n->_max_end == max_end_limit() ? std::numeric_limits< key_type >::max() : key_type(n->_max_end));
+    }
+    static void set_max_end(node_ptr n, key_type k)
+    {
+        n->_max_end = (fits_max_end(k, narrow_max_end()) ? Max_End_Type(k) : max_end_limit());
+    }
+
+private:
+    typedef std::integral_constant< bool, (std::numeric_limits< Max_End_Type >::digits
+                                           < std::numeric_limits< key_type >::digits) > narrow_max_end;
+
+    static Max_End_Type max_end_limit() { return std::numeric_limits< Max_End_Type >::max(); }
+    static bool fits_max_end(key_type k, std::true_type) { return k < key_type(max_end_limit()); }
+    static bool fits_max_end(key_type, std::false_type) { return true; }
+
+    static node_ptr decode(std::uint32_t link)
+    {
+        if (link == 0)
+        {
+            return nullptr;
+        }
+        if (link <= max_nodes)
+        {
+            return static_cast< node_ptr >(arena_base() + (link - 1));
+        }
+        return const_cast< node_ptr >(headers()[link - max_nodes - 1].load(std::memory_order_relaxed));
+    }
+
+    static std::uint32_t encode(const_node_ptr p)
+    {
+        if (not p)
+        {
+            return 0;
+        }
+        std::uintptr_t offset = reinterpret_cast< std::uintptr_t >(p)
+                                - reinterpret_cast< std::uintptr_t >(static_cast< const node* >(arena_base()));
+        if (offset < arena_size() * sizeof(T) and offset % sizeof(T) == 0)
+        {
+            return std::uint32_t(offset / sizeof(T) + 1);
+        }
+        return max_nodes + 1 + header_slot(p);
+    }
+
+    /** Get the slot of a tree header.
+     * The header caches its slot index + 1 in its max_end field, and is
+     * checked against the slot, which may have been freed or reassigned.
+     */
+    static std::uint32_t header_slot(const_node_ptr header)
+    {
+        if (Max_End_Type(0) < header->_max_end and not (Max_End_Type(max_trees) < header->_max_end))
+        {
+            std::size_t cached = std::size_t(header->_max_end);
+            if (headers()[cached - 1].load(std::memory_order_relaxed) == header)
+            {
+                return std::uint32_t(cached - 1);
+            }
+        }
+        std::uint32_t i = find_header_slot(header);
+        const_cast< node_ptr >(header)->_max_end = Max_End_Type(i + 1);
+        return i;
+    }
+
+    /** Find or allocate the slot of a tree header, in O(max_trees). */
+    static std::uint32_t find_header_slot(const_node_ptr header)
+    {
+        for (std::size_t i = 0; i < max_trees; ++i)
+        {
+            if (headers()[i].load(std::memory_order_relaxed) == header)
+            {
+                return std::uint32_t(i);
+            }
+        }
+        for (std::size_t i = 0; i < max_trees; ++i)
+        {
+            const_node_ptr expected = nullptr;
+            if (headers()[i].compare_exchange_strong(expected, header) or expected == header)
+            {
+                return std::uint32_t(i);
+            }
+        }
+        throw std::length_error("compact_itree_node_traits: too many trees");
+    }
+
+    static T*& arena_base()
+    {
+        static T* base = nullptr;
+        return base;
+    }
+    static std::size_t& arena_size()
+    {
+        static std::size_t size = 0;
+        return size;
+    }
+    static std::atomic< const_node_ptr >* headers()
+    {
+        static std::atomic< const_node_ptr > slots[max_trees];
+        return slots;
+    }
+}; // struct compact_itree_node_traits
+
+namespace detail
+{
+
+/** Owner of the header slot of a compact tree.
+ * A base of compact_itree listed before the tree, so that it is destroyed
+ * after the tree destructor, which still writes the header links.
+ */
+template < typename Node_Traits >
+struct Compact_Header_Slot
+{
+    Compact_Header_Slot() : _header(nullptr) {}
+    Compact_Header_Slot(const Compact_Header_Slot&) = delete;
+    Compact_Header_Slot& operator = (const Compact_Header_Slot&) = delete;
+    ~Compact_Header_Slot()
+    {
+        if (_header)
+        {
+            Node_Traits::release_header(_header);
+        }
+    }
+
+    typename Node_Traits::const_node_ptr _header;
+}; // struct Compact_Header_Slot
+
+} // namespace detail
+
+/** Itree over compact_itree_value_traits that owns its header slot.
+ *
+ * Behaves as ITree, and frees the header slot of the tree (see
+ * compact_itree_node_traits) when it is destroyed. For example:
+ *
+ *     typedef bi::compact_itree< bi::itree< Read, bi::value_traits< traits > > > itree_type;
+ */
+template < typename ITree >
+class compact_itree
+    : private detail::Compact_Header_Slot< typename ITree::value_traits::node_traits >,
+      public ITree
+{
+public:
+    template < typename ...Args >
+    explicit compact_itree(Args&&... args) : ITree(std::forward< Args >(args)...)
+    {
+        this->_header = this->end().pointed_node();
+    }
+
+    compact_itree(compact_itree&& other) : ITree(std::move(static_cast< ITree& >(other)))
+    {
+        this->_header = this->end().pointed_node();
+    }
+
+    compact_itree& operator = (compact_itree&& other)
+    {
+        ITree::operator = (std::move(static_cast< ITree& >(other)));
+        return *this;
+    }
+}; // class compact_itree
+
+/** Value Traits for itrees of values in a contiguous array, with 32-bit links.
+ *
+ * T must derive from compact_itree_node< Max_End_Type >, and hold the interval
+ * endpoints in the members Start and End. For example:
+ *
+ *     struct Read : bi::compact_itree_node<> { uint32_t start; uint32_t end; };
+ *     typedef bi::compact_itree_value_traits< Read, uint32_t, &Read::start, &Read::end > traits;
+ *     typedef bi::compact_itree< bi::itree< Read, bi::value_traits< traits > > > itree_type;
+ *
+ * The Node Traits arena must be set up before use (see compact_itree_node_traits).
+ */
+template < typename T, typename Key_Type, Key_Type T::*Start, Key_Type T::*End,
+           typename Max_End_Type = Key_Type, typename Tag = void >
+struct compact_itree_value_traits
+{
+    typedef T value_type;
+    typedef compact_itree_node_traits< T, Key_Type, Max_End_Type, Tag > node_traits;
+    typedef typename node_traits::key_type key_type;
+    typedef typename node_traits::node_ptr node_ptr;
+    typedef typename node_traits::const_node_ptr const_node_ptr;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    static const link_mode_type link_mode = normal_link;
+
+    static node_ptr to_node_ptr(reference value) { return &value; }
+    static const_node_ptr to_node_ptr(const_reference value) { return &value; }
+    static pointer to_value_ptr(node_ptr n) { return static_cast< pointer >(n); }
+    static const_pointer to_value_ptr(const_node_ptr n) { return static_cast< const_pointer >(n); }
+    static key_type get_start(const_node_ptr n) { return to_value_ptr(n)->*Start; }
+    static key_type get_start(const_pointer p) { return p->*Start; }
+    static key_type get_end(const_node_ptr n) { return to_value_ptr(n)->*End; }
+    static key_type get_end(const_pointer p) { return p->*End; }
+    static void set_start(pointer p, key_type k) { p->*Start = k; }
+    static void set_end(pointer p, key_type k) { p->*End = k; }
+}; // struct compact_itree_value_traits
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef __CONCURRENT_ITREE_HPP
+#define __CONCURRENT_ITREE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+#include <boost/assert.hpp>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Interval index with lock-free readers and a single writer.
+ *
+ * The writer updates an ordinary itree, and makes a batch of updates visible
+ * by calling publish(), which snapshots the tree into an immutable
+ * frozen_itree and swaps it in atomically. Readers never take locks: they
+ * announce the epoch they read in, use the current snapshot, and retract the
+ * announcement when done. Replaced snapshots are reclaimed once no reader
+ * announced an epoch older than their replacement (epoch-based reclamation),
+ * so readers always see a consistent tree, and read throughput is not
+ * affected by the writer.
+ *
+ * Every thread reading concurrently must use its own slot in [0, max_readers).
+ * The elements referenced by published snapshots must not be modified, and
+ * erased elements must be disposed of through defer().
+ */
+template < class ITree >
+class concurrent_itree
+{
+public:
+    typedef ITree tree_type;
+    typedef typename ITree::frozen_type snapshot_type;
+    typedef typename ITree::key_type key_type;
+    typedef typename ITree::value_type value_type;
+
+    // disallow copy
+    concurrent_itree(const concurrent_itree&) = delete;
+    concurrent_itree& operator = (const concurrent_itree&) = delete;
+
+    explicit concurrent_itree(std::size_t max_readers = 64)
+        : _slot_storage(new char[(max_readers + 1) * sizeof(Slot)]), _slots(nullptr), _max_readers(max_readers),
+          _current(new snapshot_type()), _epoch(1)
+    {
+        // operator new[] does not honour the alignment of Slot before C++17
+        void* p = _slot_storage.get();
+        std::size_t space = (max_readers + 1) * sizeof(Slot);
+        _slots = static_cast< Slot* >(std::align(alignof(Slot), max_readers * sizeof(Slot), p, space));
+        for (std::size_t i = 0; i < _max_readers; ++i)
+        {
+            new (&_slots[i]) Slot;
+            _slots[i].epoch.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /** Destructor. No reader may be active. */
+    ~concurrent_itree()
+    {
+        delete _current.load();
+        for (auto& r : _retired)
+        {
+            r.dispose();
+        }
+        for (auto& f : _deferred)
+        {
+            f();
+        }
+    }
+
+    std::size_t max_readers() const { return _max_readers; }
+
+    /** Writer: make the current contents of a tree visible to readers.
+     * Snapshots are replaced atomically; old ones are reclaimed when the
+     * readers that could see them are done. Every call takes O(n), to
+     * freeze() the whole tree into a new snapshot, so updates should be
+     * batched between calls.
+     */
+    void publish(const tree_type& t)
+    {
+        snapshot_type* old_snapshot = _current.exchange(new snapshot_type(t.freeze()));
+        std::uint64_t e = _epoch.fetch_add(1) + 1;
+        _retired.push_back(Retired{e, old_snapshot, std::function< void () >()});
+        for (auto& f : _deferred)
+        {
+            _retired.push_back(Retired{e, nullptr, std::move(f)});
+        }
+        _deferred.clear();
+        reclaim();
+    }
+
+    /** Writer: run an action once no reader can see the current snapshot.
+     * Used to dispose of elements erased from the tree: the action runs after
+     * the next publish(), once all readers of older snapshots are done.
+     */
+    void defer(std::function< void () > f)
+    {
+        _deferred.push_back(std::move(f));
+    }
+
+    /** Writer: reclaim the snapshots and deferred actions that are no longer reachable. */
+    void reclaim()
+    {
+        std::uint64_t min_epoch = UINT64_MAX;
+        for (std::size_t i = 0; i < _max_readers; ++i)
+        {
+            std::uint64_t e = _slots[i].epoch.load();
+            if (e != 0 and e < min_epoch)
+            {
+                min_epoch = e;
+            }
+        }
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < _retired.size(); ++i)
+        {
+            if (_retired[i].epoch <= min_epoch)
+            {
+                _retired[i].dispose();
+            }
+            else
+            {
+                if (i != j)
+                {
+                    _retired[j] = std::move(_retired[i]);
+                }
+                ++j;
+            }
+        }
+        _retired.resize(j);
+    }
+
+    /** Reader: pins the current snapshot while in scope. */
+    class read_guard
+    {
+    public:
+        read_guard(const concurrent_itree& owner, std::size_t slot)
+            : _slot(owner.slot_epoch(slot))
+        {
+            _slot.store(owner._epoch.load());
+            _snapshot = owner._current.load();
+        }
+        ~read_guard()
+        {
+            _slot.store(0, std::memory_order_release);
+        }
+        read_guard(const read_guard&) = delete;
+        read_guard& operator = (const read_guard&) = delete;
+
+        const snapshot_type& operator * () const { return *_snapshot; }
+        const snapshot_type* operator -> () const { return _snapshot; }
+
+    private:
+        std::atomic< std::uint64_t >& _slot;
+        const snapshot_type* _snapshot;
+    }; // class read_guard
+
+    /** Reader: visit intervals that intersect a given interval.
+     * @param slot Reader slot of the calling thread.
+     * @see frozen_itree::for_each_intersection()
+     */
+    template < class Visitor >
+    bool for_each_intersection(std::size_t slot, const key_type& int_start, const key_type& int_end,
+                               Visitor&& visitor) const
+    {
+        read_guard g(*this, slot);
+        return g->for_each_intersection(int_start, int_end, visitor);
+    }
+
+    /** Reader: return intervals that intersect a given interval.
+     * @param slot Reader slot of the calling thread.
+     * @see frozen_itree::iintersect()
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(std::size_t slot, const key_type& int_start, const key_type& int_end,
+                               Output_Iterator out) const
+    {
+        read_guard g(*this, slot);
+        return g->iintersect(int_start, int_end, out);
+    }
+
+private:
+    // one cache line per reader, to avoid false sharing
+    struct alignas(64) Slot
+    {
+        std::atomic< std::uint64_t > epoch;
+    };
+    static_assert(sizeof(Slot) == 64, "reader slots should fill a cache line");
+
+    /** Epoch announced in a reader slot. */
+    std::atomic< std::uint64_t >& slot_epoch(std::size_t slot) const
+    {
+        BOOST_ASSERT(slot < _max_readers);
+        return _slots[slot].epoch;
+    }
+
+    struct Retired
+    {
+        std::uint64_t epoch;
+        snapshot_type* snapshot;
+        std::function< void () > action;
+
+        void dispose()
+        {
+            delete snapshot;
+            if (action)
+            {
+                action();
+            }
+        }
+    };
+
+    std::unique_ptr< char[] > _slot_storage;
+    Slot* _slots;
+    std::size_t _max_readers;
+    std::atomic< snapshot_type* > _current;
+    std::atomic< std::uint64_t > _epoch;
+    // writer-only state
+    std::vector< Retired > _retired;
+    std::vector< std::function< void () > > _deferred;
+}; // class concurrent_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef __COUNTING_ITREE_HPP
+#define __COUNTING_ITREE_HPP
+
+#include <type_traits>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Interval tree that keeps its end index, for intersection counts.
+ *
+ * itree_impl::iintersect_count() needs a second counting itree on the same
+ * intervals, ordered by end, that the caller keeps in sync. This class owns
+ * both trees, and only exposes the updates that it mirrors on the end index,
+ * so that iintersect_count(int_start, int_end) is always valid. Elements
+ * must be linkable in both trees (two sets of hooks), and are not owned.
+ *
+ * ITree and End_Index are itrees on the same value type, whose Node Traits
+ * provide get_count()/set_count(); the Value Traits get_start() of End_Index
+ * returns the interval end. Queries use tree() and end_index(); other
+ * updates, such as split() or shift_from(), are not supported.
+ */
+template < class ITree, class End_Index >
+class counting_itree
+{
+public:
+    typedef ITree itree_type;
+    typedef End_Index end_index_type;
+    typedef typename ITree::value_type value_type;
+    typedef typename ITree::key_type key_type;
+    typedef typename ITree::size_type size_type;
+    typedef typename ITree::iterator iterator;
+    typedef typename ITree::const_iterator const_iterator;
+    static_assert(std::is_same< typename End_Index::value_type, value_type >::value,
+                  "counting_itree: trees on different value types");
+
+    // disallow copy
+    counting_itree(const counting_itree&) = delete;
+    counting_itree& operator = (const counting_itree&) = delete;
+
+    counting_itree() {}
+
+    template < class Iterator >
+    counting_itree(Iterator b, Iterator e) : _tree(b, e), _end_index(b, e) {}
+
+    counting_itree(counting_itree&& other) = default;
+
+    ~counting_itree() { clear(); }
+
+    /** The interval tree, for queries. */
+    const itree_type& tree() const { return _tree; }
+    /** The tree of the same intervals, keyed by end. */
+    const end_index_type& end_index() const { return _end_index; }
+
+    size_type size() const { return _tree.size(); }
+    bool empty() const { return _tree.empty(); }
+    iterator begin() { return _tree.begin(); }
+    iterator end() { return _tree.end(); }
+    const_iterator begin() const { return _tree.begin(); }
+    const_iterator end() const { return _tree.end(); }
+    iterator iterator_to(value_type& v) { return _tree.iterator_to(v); }
+    const_iterator iterator_to(const value_type& v) const { return _tree.iterator_to(v); }
+
+    /** Insert an interval in both trees.
+     * @return Iterator to the interval.
+     */
+    iterator insert(value_type& v)
+    {
+        _end_index.insert(v);
+        return _tree.insert(v);
+    }
+
+    /** Erase an interval from both trees.
+     * @return Iterator to the next interval.
+     */
+    iterator erase(const_iterator it)
+    {
+        _end_index.erase(_end_index.iterator_to(*it));
+        return _tree.erase(it);
+    }
+
+    /** Remove all intervals from both trees. */
+    void clear()
+    {
+        _end_index.clear();
+        _tree.clear();
+    }
+
+    /** Change the end of an interval; it is reinserted in the end index. */
+    void update_end(iterator it, const key_type& new_end)
+    {
+        _end_index.erase(_end_index.iterator_to(*it));
+        _tree.update_end(it, new_end);
+        _end_index.insert(*it);
+    }
+
+    /** Change the start of an interval; the end index is unaffected.
+     * @return Iterator to the updated interval.
+     */
+    iterator update_start(iterator it, const key_type& new_start)
+    {
+        return _tree.update_start(it, new_start);
+    }
+
+    /** Count intervals that intersect a given interval, in O(log n).
+     * @see itree_impl::iintersect_count()
+     */
+    size_type iintersect_count(const key_type& int_start, const key_type& int_end) const
+    {
+        return _tree.iintersect_count(int_start, int_end, _end_index);
+    }
+
+private:
+    itree_type _tree;
+    end_index_type _end_index;
+}; // class counting_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
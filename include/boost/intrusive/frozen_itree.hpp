@@ -0,0 +1,218 @@
+#ifndef __FROZEN_ITREE_HPP
+#define __FROZEN_ITREE_HPP
+
+#include <climits>
+#include <cstddef>
+#include <vector>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Algorithms for implicit interval trees.
+ *
+ * An implicit interval tree is stored in arrays sorted by interval start.
+ * The node for the index range [lo, hi) is mid = lo + (hi - lo) / 2, its
+ * children are the ranges [lo, mid) and [mid + 1, hi), and max_ends[mid]
+ * holds the maximum end in [lo, hi). No links are stored.
+ */
+template < typename Key_Type >
+struct implicit_itree_algorithms
+{
+    typedef Key_Type key_type;
+
+    /** Compute max_ends for the implicit tree over ends[0..n).
+     * @return Maximum end in the range (undefined if n == 0).
+     */
+    static key_type build_max_ends(const key_type* ends, key_type* max_ends, std::size_t n)
+    {
+        return build_max_ends(ends, max_ends, 0, n);
+    }
+
+    /** Visit the intervals that intersect [int_start, int_end].
+     * Pruned in-order traversal with an explicit stack of index ranges.
+     * @param visitor Callback invoked as visitor(index) for every intersecting
+     * interval, in index order; returning false stops the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < typename Visitor >
+    static bool for_each_intersection(const key_type* starts, const key_type* ends, const key_type* max_ends,
+                                      std::size_t n, const key_type& int_start, const key_type& int_end,
+                                      Visitor&& visitor)
+    {
+        std::size_t stack_lo[2 * CHAR_BIT * sizeof(std::size_t)];
+        std::size_t stack_hi[2 * CHAR_BIT * sizeof(std::size_t)];
+        std::size_t depth = 0;
+        std::size_t lo = 0;
+        std::size_t hi = n;
+        if (n == 0 or max_ends[mid(lo, hi)] < int_start)
+        {
+            return true;
+        }
+        while (true)
+        {
+            // descend into left strees that can intersect
+            while (lo < mid(lo, hi) and not (max_ends[mid(lo, mid(lo, hi))] < int_start))
+            {
+                stack_lo[depth] = lo;
+                stack_hi[depth] = hi;
+                ++depth;
+                hi = mid(lo, hi);
+            }
+            while (true)
+            {
+                std::size_t m = mid(lo, hi);
+                if (int_end < starts[m])
+                {
+                    // this and all remaining intervals start after the query
+                    return true;
+                }
+                if (not (ends[m] < int_start) and not visitor(m))
+                {
+                    return false;
+                }
+                if (m + 1 < hi and not (max_ends[mid(m + 1, hi)] < int_start))
+                {
+                    lo = m + 1;
+                    break;
+                }
+                if (depth == 0)
+                {
+                    return true;
+                }
+                --depth;
+                lo = stack_lo[depth];
+                hi = stack_hi[depth];
+            }
+        }
+    }
+
+private:
+    static std::size_t mid(std::size_t lo, std::size_t hi)
+    {
+        return lo + (hi - lo) / 2;
+    }
+
+    static key_type build_max_ends(const key_type* ends, key_type* max_ends, std::size_t lo, std::size_t hi)
+    {
+        std::size_t m = mid(lo, hi);
+        key_type res = ends[m];
+        if (lo < m)
+        {
+            key_type tmp = build_max_ends(ends, max_ends, lo, m);
+            if (res < tmp)
+            {
+                res = tmp;
+            }
+        }
+        if (m + 1 < hi)
+        {
+            key_type tmp = build_max_ends(ends, max_ends, m + 1, hi);
+            if (res < tmp)
+            {
+                res = tmp;
+            }
+        }
+        max_ends[m] = res;
+        return res;
+    }
+}; // struct implicit_itree_algorithms
+
+/** Immutable snapshot of an interval tree.
+ *
+ * Starts, ends and max_ends are kept in separate contiguous arrays forming an
+ * implicit interval tree (see implicit_itree_algorithms), next to pointers
+ * back to the original elements. Queries give the same results, in the same
+ * order, as those on the original itree, while touching far fewer cache
+ * lines. The snapshot is not updated when the original tree changes.
+ */
+template < typename Value_Traits >
+class frozen_itree
+{
+public:
+    typedef typename Value_Traits::value_type value_type;
+    typedef typename Value_Traits::key_type key_type;
+    typedef typename Value_Traits::const_pointer const_pointer;
+    typedef std::size_t size_type;
+    typedef implicit_itree_algorithms< key_type > implicit_algo;
+
+    frozen_itree() {}
+
+    /** Build snapshot of a range of values sorted by interval start.
+     * The iteration order of an itree satisfies this requirement.
+     */
+    template < class Iterator >
+    frozen_itree(Iterator b, Iterator e)
+    {
+        for (; b != e; ++b)
+        {
+            const_pointer p = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(*b));
+            _starts.push_back(Value_Traits::get_start(p));
+            _ends.push_back(Value_Traits::get_end(p));
+            _values.push_back(p);
+        }
+        _max_ends.resize(_ends.size());
+        if (not _ends.empty())
+        {
+            implicit_algo::build_max_ends(_ends.data(), _max_ends.data(), _ends.size());
+        }
+    }
+
+    size_type size() const { return _values.size(); }
+    bool empty() const { return _values.empty(); }
+
+    /** Pointer to the original element at a given position (in start order). */
+    const_pointer value(size_type i) const { return _values[i]; }
+    const key_type& start(size_type i) const { return _starts[i]; }
+    const key_type& end(size_type i) const { return _ends[i]; }
+
+    /** Get maximum right endpoint in the snapshot. */
+    key_type max_end() const
+    {
+        return _max_ends.empty() ? key_type() : _max_ends[_max_ends.size() / 2];
+    }
+
+    /** Visit intervals that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(value) in start order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        return implicit_algo::for_each_intersection(
+            _starts.data(), _ends.data(), _max_ends.data(), size(), int_start, int_end,
+            [&] (size_type i) { return visitor(*_values[i]); });
+    }
+
+    /** Return intervals that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param out Output iterator receiving pointers to the original elements,
+     * in start order.
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(const key_type& int_start, const key_type& int_end, Output_Iterator out) const
+    {
+        implicit_algo::for_each_intersection(
+            _starts.data(), _ends.data(), _max_ends.data(), size(), int_start, int_end,
+            [&] (size_type i) { *out++ = _values[i]; return true; });
+        return out;
+    }
+
+private:
+    std::vector< key_type > _starts;
+    std::vector< key_type > _ends;
+    std::vector< key_type > _max_ends;
+    std::vector< const_pointer > _values;
+}; // class frozen_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
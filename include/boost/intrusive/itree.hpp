@@ -1,12 +1,23 @@
 #ifndef __ITREE_HPP
 #define __ITREE_HPP
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/assert.hpp>
 #include <boost/intrusive/set.hpp>
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/range/iterator_range.hpp>
 #include <boost/mpl/if.hpp>
 #include <boost/tti/tti.hpp>
 #include "itree_algorithms.hpp"
+#include "itree_augment.hpp"
+#include "itree_stats.hpp"
+#include "frozen_itree.hpp"
 
 
 namespace boost
@@ -22,13 +33,67 @@ BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(get_max_end)
 BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(set_max_end)
 BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(get_start)
 BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(get_end)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(get_count)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(set_count)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(get_min_end)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(set_min_end)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(get_augment)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(set_augment)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(set_start)
+BOOST_TTI_HAS_STATIC_MEMBER_FUNCTION(set_end)
+
+/** Saturating distances between integral keys.
+ *
+ * A distance is stored in the key type itself, so it saturates at the
+ * maximum key, which then reads back as unbounded: distances are never
+ * under-estimated, and endpoints derived from them never prune a subtree
+ * that holds a hit. The arithmetic never overflows, with signed keys either.
+ */
+template < typename Key >
+struct Key_Distance
+{
+    typedef typename std::make_unsigned< Key >::type unsigned_type;
+
+    static Key max() { return std::numeric_limits< Key >::max(); }
+    static Key min() { return std::numeric_limits< Key >::min(); }
+
+    /** Distance hi - lo, for lo <= hi. */
+    static Key diff(Key hi, Key lo)
+    {
+        unsigned_type d = unsigned_type(unsigned_type(hi) - unsigned_type(lo));
+        return d < unsigned_type(max()) ? Key(d) : max();
+    }
+    /** Key at distance d above base. */
+    static Key add(Key base, Key d)
+    {
+        return (d == max() or max() - d < base) ? max() : Key(base + d);
+    }
+    /** Key at distance d below base. */
+    static Key sub(Key base, Key d)
+    {
+        return (d == max() or base < Key(min() + d)) ? min() : Key(base - d);
+    }
+}; // struct Key_Distance
 
 /** Node Traits adaptor for Interval Tree.
  *
  * This Traits class defines the node maintenance methods that hook into
- * the rbtree algorithms.
+ * the rbtree algorithms. If the Node Traits provide get_count()/set_count(),
+ * subtree sizes are maintained alongside max_end. If they provide
+ * get_min_end()/set_min_end(), so is the minimum end of every subtree.
+ * The aggregates of the Augment policies (see itree_augment) are computed
+ * in the same pass, and stored with get_augment()/set_augment().
+ *
+ * With integral keys, the max_end field is stored relative to the end of
+ * its node, as the distance (max_end - end), and min_end as (end - min_end);
+ * get_max_end()/set_max_end() and get_min_end()/set_min_end() convert to
+ * absolute values. Shifting all intervals of a subtree by the same amount
+ * thus leaves the stored values unchanged (see itree_impl::implement_shift()).
+ * Distances saturate (see Key_Distance), so a subtree spanning more than the
+ * key range reads as unbounded. Other keys, such as floating point ones, are
+ * stored as absolute values, which are exact but must be updated on shifts.
  */
-template < typename Value_Traits >
+template < typename Value_Traits, typename Augment = itree_augment_list<> >
 struct ITree_Node_Traits : public Value_Traits::node_traits
 {
 private:
@@ -46,35 +111,204 @@ public:
     using typename Base::const_node_ptr;
     using typename Base::key_type;
 
+    static const bool has_count =
+        has_static_member_function_get_count< Base, std::size_t (const_node_ptr) >::value
+        and has_static_member_function_set_count< Base, void (node_ptr, std::size_t) >::value;
+    static const bool has_min_end =
+        has_static_member_function_get_min_end< Base, key_type (const_node_ptr) >::value
+        and has_static_member_function_set_min_end< Base, void (node_ptr, key_type) >::value;
+
+    typedef Augment augment_type;
+    typedef typename Augment::data_type augment_data;
+    static const bool has_augment = (Augment::size > 0);
+    static_assert(not has_augment
+                  or (has_static_member_function_get_augment< Base, const augment_data& (const_node_ptr) >::value
+                      and has_static_member_function_set_augment< Base, void (node_ptr, const augment_data&) >::value),
+                  "Node Traits missing get_augment()/set_augment() for the itree_augment policies");
+
+    /** Whether max_end and min_end are stored relative to the node end. */
+    static const bool relative_ends = std::is_integral< key_type >::value;
+    typedef std::integral_constant< bool, relative_ends > relative_ends_type;
+
+    static key_type get_max_end(const_node_ptr n)
+    {
+        return get_max_end(n, relative_ends_type());
+    }
+    static void set_max_end(node_ptr n, key_type k)
+    {
+        set_max_end(n, k, relative_ends_type());
+    }
+    static key_type get_min_end(const_node_ptr n)
+    {
+        static_assert(has_min_end, "Node Traits missing get_min_end()/set_min_end()");
+        return get_min_end(n, relative_ends_type());
+    }
+    static void set_min_end(node_ptr n, key_type k)
+    {
+        static_assert(has_min_end, "Node Traits missing get_min_end()/set_min_end()");
+        set_min_end(n, k, relative_ends_type());
+    }
+
+    /** Aggregate of a policy over the subtree rooted at n. */
+    template < typename Policy >
+    static typename Policy::value_type get_aggregate(const_node_ptr n)
+    {
+        return std::get< Augment_Index_In< Policy, Augment >::value >(Base::get_augment(n));
+    }
+    /** Aggregate of a policy over the interval of n alone. */
+    template < typename Policy >
+    static typename Policy::value_type get_node_aggregate(const_node_ptr n)
+    {
+        return Policy::from_value(*Value_Traits::to_value_ptr(n), get_start(n), get_end(n));
+    }
+
     static void init_data(node_ptr n)
     {
-        Base::set_max_end(n, Value_Traits::get_end(Value_Traits::to_value_ptr(n)));
+        set_max_end(n, get_end(n));
+        init_min_end(n, std::integral_constant< bool, has_min_end >());
+        init_augment(n, std::integral_constant< bool, has_augment >());
     }
     static void recompute_extra_data(node_ptr n)
     {
-        init_data(n);
-        key_type tmp = Base::get_max_end(n);
+        key_type tmp = get_end(n);
         if (Base::get_left(n))
         {
-            tmp = std::max(tmp, Base::get_max_end(Base::get_left(n)));
+            tmp = std::max(tmp, get_max_end(Base::get_left(n)));
         }
         if (Base::get_right(n))
         {
-            tmp = std::max(tmp, Base::get_max_end(Base::get_right(n)));
+            tmp = std::max(tmp, get_max_end(Base::get_right(n)));
         }
-        Base::set_max_end(n, tmp);
+        set_max_end(n, tmp);
+        recompute_count(n, std::integral_constant< bool, has_count >());
+        recompute_min_end(n, std::integral_constant< bool, has_min_end >());
+        recompute_augment(n, std::integral_constant< bool, has_augment >());
     }
     static void clone_extra_data(node_ptr dest, const_node_ptr src)
     {
         Base::set_max_end(dest, Base::get_max_end(src));
+        clone_count(dest, src, std::integral_constant< bool, has_count >());
+        clone_min_end(dest, src, std::integral_constant< bool, has_min_end >());
+        clone_augment(dest, src, std::integral_constant< bool, has_augment >());
+    }
+
+private:
+    static key_type get_start(const_node_ptr n)
+    {
+        return Value_Traits::get_start(Value_Traits::to_value_ptr(n));
+    }
+    static key_type get_end(const_node_ptr n)
+    {
+        return Value_Traits::get_end(Value_Traits::to_value_ptr(n));
     }
+
+    static key_type get_max_end(const_node_ptr n, std::true_type)
+    {
+        return Key_Distance< key_type >::add(get_end(n), Base::get_max_end(n));
+    }
+    static key_type get_max_end(const_node_ptr n, std::false_type)
+    {
+        return Base::get_max_end(n);
+    }
+    static void set_max_end(node_ptr n, key_type k, std::true_type)
+    {
+        Base::set_max_end(n, Key_Distance< key_type >::diff(k, get_end(n)));
+    }
+    static void set_max_end(node_ptr n, key_type k, std::false_type)
+    {
+        Base::set_max_end(n, k);
+    }
+    static key_type get_min_end(const_node_ptr n, std::true_type)
+    {
+        return Key_Distance< key_type >::sub(get_end(n), Base::get_min_end(n));
+    }
+    static key_type get_min_end(const_node_ptr n, std::false_type)
+    {
+        return Base::get_min_end(n);
+    }
+    static void set_min_end(node_ptr n, key_type k, std::true_type)
+    {
+        Base::set_min_end(n, Key_Distance< key_type >::diff(get_end(n), k));
+    }
+    static void set_min_end(node_ptr n, key_type k, std::false_type)
+    {
+        Base::set_min_end(n, k);
+    }
+
+    static void recompute_count(node_ptr n, std::true_type)
+    {
+        std::size_t tmp = 1;
+        if (Base::get_left(n))
+        {
+            tmp += Base::get_count(Base::get_left(n));
+        }
+        if (Base::get_right(n))
+        {
+            tmp += Base::get_count(Base::get_right(n));
+        }
+        Base::set_count(n, tmp);
+    }
+    static void recompute_count(node_ptr, std::false_type) {}
+    static void clone_count(node_ptr dest, const_node_ptr src, std::true_type)
+    {
+        Base::set_count(dest, Base::get_count(src));
+    }
+    static void clone_count(node_ptr, const_node_ptr, std::false_type) {}
+
+    static void init_min_end(node_ptr n, std::true_type)
+    {
+        set_min_end(n, get_end(n));
+    }
+    static void init_min_end(node_ptr, std::false_type) {}
+    static void recompute_min_end(node_ptr n, std::true_type)
+    {
+        key_type tmp = get_end(n);
+        if (Base::get_left(n))
+        {
+            tmp = std::min(tmp, get_min_end(Base::get_left(n)));
+        }
+        if (Base::get_right(n))
+        {
+            tmp = std::min(tmp, get_min_end(Base::get_right(n)));
+        }
+        set_min_end(n, tmp);
+    }
+    static void recompute_min_end(node_ptr, std::false_type) {}
+    static void clone_min_end(node_ptr dest, const_node_ptr src, std::true_type)
+    {
+        Base::set_min_end(dest, Base::get_min_end(src));
+    }
+    static void clone_min_end(node_ptr, const_node_ptr, std::false_type) {}
+
+    static void init_augment(node_ptr n, std::true_type)
+    {
+        augment_data tmp;
+        Augment_Ops< Augment >::identity(tmp);
+        Base::set_augment(n, tmp);
+    }
+    static void init_augment(node_ptr, std::false_type) {}
+    static void recompute_augment(node_ptr n, std::true_type)
+    {
+        augment_data tmp;
+        Augment_Ops< Augment >::recompute(tmp,
+                                          Base::get_left(n) ? &Base::get_augment(Base::get_left(n)) : nullptr,
+                                          Base::get_right(n) ? &Base::get_augment(Base::get_right(n)) : nullptr,
+                                          *Value_Traits::to_value_ptr(n), get_start(n), get_end(n));
+        Base::set_augment(n, tmp);
+    }
+    static void recompute_augment(node_ptr, std::false_type) {}
+    static void clone_augment(node_ptr dest, const_node_ptr src, std::true_type)
+    {
+        Base::set_augment(dest, Base::get_augment(src));
+    }
+    static void clone_augment(node_ptr, const_node_ptr, std::false_type) {}
 }; // struct ITree_Node_Traits
 
 /** Value Traits adaptor class for Interval Tree.
  *
  * The only function is to change the node_traits typedef.
  */
-template < typename Value_Traits >
+template < typename Value_Traits, typename Augment = itree_augment_list<> >
 struct ITree_Value_Traits : public Value_Traits
 {
 private:
@@ -91,7 +325,7 @@ private:
     static_assert(has_static_member_function_get_end< Base, typename Base::key_type (const typename Base::value_type*)>::value,
                   "Value Traits missing get_end(const value_type*)");
 public:
-    typedef ITree_Node_Traits< Value_Traits > node_traits;
+    typedef ITree_Node_Traits< Value_Traits, Augment > node_traits;
 }; // struct ITree_Value_Traits
 
 /** Comparator for Interval Tree. */
@@ -105,9 +339,14 @@ struct ITree_Compare
     }
 }; // struct ITree_Compare
 
-template < typename Value_Traits, bool is_const >
-class Intersection_Iterator
-    : public boost::iterator_facade< Intersection_Iterator< Value_Traits, is_const >,
+/** Iterator over the nodes matching a query.
+ *
+ * The Query policy holds the query keys, and finds the next matching node
+ * given the current node and a traversal stage (see itree_algorithms).
+ */
+template < typename Value_Traits, typename Query, bool is_const >
+class Query_Iterator
+    : public boost::iterator_facade< Query_Iterator< Value_Traits, Query, is_const >,
                                      typename Value_Traits::value_type,
                                      boost::forward_traversal_tag,
                                      typename boost::mpl::if_c< is_const,
@@ -117,7 +356,7 @@ class Intersection_Iterator
                                    >
 {
 public:
-    typedef boost::iterator_facade< Intersection_Iterator< Value_Traits, is_const >,
+    typedef boost::iterator_facade< Query_Iterator< Value_Traits, Query, is_const >,
                                     typename Value_Traits::value_type,
                                     boost::forward_traversal_tag,
                                     typename boost::mpl::if_c< is_const,
@@ -139,48 +378,74 @@ public:
                                        value_type*
                                      >::type qual_node_raw_ptr;
 
-    Intersection_Iterator() {}
-    explicit Intersection_Iterator(qual_node_ptr node, key_type int_start = 0, key_type int_end = 0)
-    : _node(pointer_traits< node_ptr >::const_cast_from(node)), _int_start(int_start), _int_end(int_end) {}
+    Query_Iterator() {}
+    explicit Query_Iterator(qual_node_ptr node, const Query& query = Query())
+    : _node(pointer_traits< node_ptr >::const_cast_from(node)), _query(query) {}
 
     // implicit conversion to const
-    operator const Intersection_Iterator< Value_Traits, true >& () const
-    { return *reinterpret_cast< const Intersection_Iterator< Value_Traits, true >* >(this); }
-    operator Intersection_Iterator< Value_Traits, true >& ()
-    { return *reinterpret_cast< Intersection_Iterator< Value_Traits, true >* >(this); }
+    operator const Query_Iterator< Value_Traits, Query, true >& () const
+    { return *reinterpret_cast< const Query_Iterator< Value_Traits, Query, true >* >(this); }
+    operator Query_Iterator< Value_Traits, Query, true >& ()
+    { return *reinterpret_cast< Query_Iterator< Value_Traits, Query, true >* >(this); }
 
     // explicit conversion to non-const
-    const Intersection_Iterator< Value_Traits, false >& unconst() const
-    { return *reinterpret_cast< const Intersection_Iterator< Value_Traits, false >* >(this); }
-    Intersection_Iterator< Value_Traits, false >& unconst()
-    { return *reinterpret_cast< Intersection_Iterator< Value_Traits, false >* >(this); }
+    const Query_Iterator< Value_Traits, Query, false >& unconst() const
+    { return *reinterpret_cast< const Query_Iterator< Value_Traits, Query, false >* >(this); }
+    Query_Iterator< Value_Traits, Query, false >& unconst()
+    { return *reinterpret_cast< Query_Iterator< Value_Traits, Query, false >* >(this); }
 
     qual_node_raw_ptr operator -> () const { return (&dereference()).operator ->(); }
 
 private:
     friend class boost::iterator_core_access;
 
-    typedef itree_algorithms< Value_Traits > itree_algo;
-
-    bool equal(const Intersection_Iterator& rhs) const { return _node == rhs._node; }
-    void increment() { _node = itree_algo::get_next_interval(_int_start, _int_end, _node, 2); }
+    bool equal(const Query_Iterator& rhs) const { return _node == rhs._node; }
+    void increment() { _node = _query.get_next(_node, 2); }
     qual_reference dereference() const { return *Value_Traits::to_value_ptr(_node); }
 
     node_ptr _node;
-    key_type _int_start;
-    key_type _int_end;
-}; // class Intersection_Iterator
+    Query _query;
+}; // class Query_Iterator
+
+/** Iterator over intervals intersecting a query interval. */
+template < typename Value_Traits, bool is_const, typename Stats = null_itree_stats >
+using Intersection_Iterator = Query_Iterator< Value_Traits, typename itree_algorithms< Value_Traits >::template Intersection_Query< Stats >, is_const >;
+
+/** Iterator over intervals containing a query point. */
+template < typename Value_Traits, bool is_const, typename Stats = null_itree_stats >
+using Stab_Iterator = Query_Iterator< Value_Traits, typename itree_algorithms< Value_Traits >::template Stab_Query< Stats >, is_const >;
+
+/** Iterator over intervals containing a query interval. */
+template < typename Value_Traits, bool is_const, typename Stats = null_itree_stats >
+using Containing_Iterator = Query_Iterator< Value_Traits, typename itree_algorithms< Value_Traits >::template Containing_Query< Stats >, is_const >;
+
+/** Iterator over intervals contained in a query interval. */
+template < typename Value_Traits, bool is_const, typename Stats = null_itree_stats >
+using Contained_In_Iterator = Query_Iterator< Value_Traits, typename itree_algorithms< Value_Traits >::template Contained_In_Query< Stats >, is_const >;
 
 } // namespace detail
 
-template < class Value_Traits, class Compare, class Size_Type, bool Constant_Time_Size >
+/** Interval tree: a multiset of intervals ordered by start, augmented with
+ * the maximum end of every subtree.
+ *
+ * The user Node Traits provide the storage of max_end (see ITree_Node_Traits).
+ * With integral keys, the field (e.g. a _max_end member) does not hold the
+ * maximum end of the subtree but its distance to the end of the node, and
+ * should only be accessed through the tree. Use itree rather than this class.
+ */
+template < class Value_Traits, class Compare, class Size_Type, bool Constant_Time_Size,
+           class Stats = null_itree_stats >
 class itree_impl
-    : public multiset_impl< Value_Traits, Compare, Size_Type, Constant_Time_Size >
+    : public multiset_impl< Value_Traits, Compare, Size_Type, Constant_Time_Size >,
+      private detail::Stats_Holder< Stats >
 {
 public:
     typedef multiset_impl< Value_Traits, Compare, Size_Type, Constant_Time_Size > Base;
     using typename Base::value_compare;
     using typename Base::value_traits;
+    using typename Base::size_type;
+    using typename Base::iterator;
+    using typename Base::const_iterator;
     typedef itree_algorithms< Value_Traits > itree_algo;
     typedef typename Value_Traits::node_traits Node_Traits;
     typedef typename Value_Traits::key_type key_type;
@@ -188,10 +453,24 @@ public:
     typedef typename Value_Traits::const_pointer const_pointer;
     typedef typename Value_Traits::node_ptr node_ptr;
     typedef typename Value_Traits::const_node_ptr const_node_ptr;
-    typedef detail::Intersection_Iterator< Value_Traits, false > intersection_iterator;
-    typedef detail::Intersection_Iterator< Value_Traits, true > intersection_const_iterator;
-    typedef boost::iterator_range< detail::Intersection_Iterator< Value_Traits, false > > intersection_iterator_range;
-    typedef boost::iterator_range< detail::Intersection_Iterator< Value_Traits, true > > intersection_const_iterator_range;
+    typedef Stats stats_type;
+    typedef detail::Intersection_Iterator< Value_Traits, false, Stats > intersection_iterator;
+    typedef detail::Intersection_Iterator< Value_Traits, true, Stats > intersection_const_iterator;
+    typedef boost::iterator_range< intersection_iterator > intersection_iterator_range;
+    typedef boost::iterator_range< intersection_const_iterator > intersection_const_iterator_range;
+    typedef detail::Stab_Iterator< Value_Traits, false, Stats > stab_iterator;
+    typedef detail::Stab_Iterator< Value_Traits, true, Stats > stab_const_iterator;
+    typedef boost::iterator_range< stab_iterator > stab_iterator_range;
+    typedef boost::iterator_range< stab_const_iterator > stab_const_iterator_range;
+    typedef detail::Containing_Iterator< Value_Traits, false, Stats > containing_iterator;
+    typedef detail::Containing_Iterator< Value_Traits, true, Stats > containing_const_iterator;
+    typedef boost::iterator_range< containing_iterator > containing_iterator_range;
+    typedef boost::iterator_range< containing_const_iterator > containing_const_iterator_range;
+    typedef detail::Contained_In_Iterator< Value_Traits, false, Stats > contained_in_iterator;
+    typedef detail::Contained_In_Iterator< Value_Traits, true, Stats > contained_in_const_iterator;
+    typedef boost::iterator_range< contained_in_iterator > contained_in_iterator_range;
+    typedef boost::iterator_range< contained_in_const_iterator > contained_in_const_iterator_range;
+    typedef frozen_itree< Value_Traits > frozen_type;
 
     // disallow copy
     itree_impl(const itree_impl&) = delete;
@@ -206,8 +485,10 @@ public:
     itree_impl(Iterator b, Iterator e,
                const value_compare& cmp = value_compare(),
                const value_traits& v_traits = value_traits())
-        : Base(false, b, e, cmp, v_traits)
-    {}
+        : Base(cmp, v_traits)
+    {
+        bulk_load(b, e);
+    }
 
     itree_impl(itree_impl&& x)
         :  Base(std::move(static_cast< Base& >(x)))
@@ -227,55 +508,655 @@ public:
                                    iintersect_end());
     }
 
-    /** Get maximum right endpoint is the tree. */
+    /** Visit intervals in the tree that intersect a given interval.
+     * Faster than iterating over iintersect() when the loop body is small: the
+     * traversal is done in one pass, and the visitor can be inlined.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(value) in tree order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        stats().begin_query();
+        return itree_algo::for_each_intersection(
+            Node_Traits::get_parent(this->header_ptr()), int_start, int_end,
+            [&] (const_node_ptr n) { return visitor(*Value_Traits::to_value_ptr(n)); },
+            stats());
+    }
+
+    /** Return intervals in the tree that contain a given point.
+     * Equivalent to iintersect(point, point), with cheaper per-node tests.
+     * @param point Query point.
+     * @return An iterator range for the intervals (begin, end).
+     */
+    stab_const_iterator_range istab(const key_type& point) const
+    {
+        return make_iterator_range(istab_begin(point),
+                                   stab_const_iterator(this->header_ptr()));
+    }
+
+    /** Return intervals in the tree that contain a given interval.
+     * Same as the intervals of iintersect(int_start, int_end) with start <=
+     * int_start and end >= int_end, without visiting the others: subtrees
+     * are pruned when their max_end is before int_end, and nodes starting
+     * after int_start end the traversal of their subtree.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @return An iterator range for the intervals (begin, end).
+     */
+    containing_const_iterator_range icontaining(const key_type& int_start, const key_type& int_end) const
+    {
+        return make_iterator_range(
+            query_begin< containing_const_iterator >(
+                typename itree_algo::template Containing_Query< Stats >(int_start, int_end, &stats())),
+            containing_const_iterator(this->header_ptr()));
+    }
+
+    /** Return intervals in the tree that are contained in a given interval.
+     * Only the subtrees with starts in [int_start, int_end] are visited. If
+     * Node Traits provide get_min_end()/set_min_end(), subtrees whose
+     * intervals all end after int_end are pruned as well.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @return An iterator range for the intervals (begin, end).
+     */
+    contained_in_const_iterator_range icontained_in(const key_type& int_start, const key_type& int_end) const
+    {
+        return make_iterator_range(
+            query_begin< contained_in_const_iterator >(
+                typename itree_algo::template Contained_In_Query< Stats >(int_start, int_end, &stats())),
+            contained_in_const_iterator(this->header_ptr()));
+    }
+
+    /** Answer a batch of intersection queries in one coordinated traversal.
+     * Queries are sorted by start (unless already sorted), and the tree is
+     * traversed once for all of them, so that the descent work shared by
+     * nearby queries is done only once.
+     * @param b Query range begin; queries are pairs (start, end).
+     * @param e Query range end.
+     * @param sink Callback invoked as sink(query_index, value) for every
+     * intersection, where query_index is the position of the query in [b, e).
+     * For each query, values are reported in tree order.
+     * @param sorted True if the queries are already sorted by start.
+     */
+    template < class Query_Iterator, class Sink >
+    void iintersect_batch(Query_Iterator b, Query_Iterator e, Sink sink, bool sorted = false) const
+    {
+        const_node_ptr root = Node_Traits::get_parent(this->header_ptr());
+        if (not root or b == e)
+        {
+            return;
+        }
+        std::size_t n_queries = std::distance(b, e);
+        std::vector< std::size_t > idx(n_queries);
+        for (std::size_t i = 0; i < n_queries; ++i)
+        {
+            idx[i] = i;
+        }
+        if (not sorted)
+        {
+            std::stable_sort(idx.begin(), idx.end(), [&] (std::size_t lhs, std::size_t rhs) {
+                return b[lhs].first < b[rhs].first;
+            });
+        }
+        // only queries starting before the max end can intersect anything
+        key_type root_max_end = Node_Traits::get_max_end(root);
+        std::size_t hi = 0;
+        while (hi < n_queries and b[idx[hi]].first <= root_max_end)
+        {
+            ++hi;
+        }
+        idx.resize(hi);
+        auto node_sink = [&] (std::size_t q, const_node_ptr n) {
+            sink(q, *Value_Traits::to_value_ptr(n));
+        };
+        if (hi > 0)
+        {
+            itree_algo::batch_intersect(root, b, idx, 0, hi, node_sink);
+        }
+    }
+
+    /** Answer a batch of unsorted intersection queries, hiding memory latency.
+     * Runs the traversals of up to group_size queries round-robin, each
+     * switching to the next after prefetching the child node it descends
+     * into, so that the cache misses of the queries overlap. Useful for
+     * random queries on trees much larger than the cache, where
+     * iintersect_batch() finds little shared work. Statistics are not recorded.
+     * @param b Query range begin; queries are pairs (start, end).
+     * @param e Query range end.
+     * @param sink Callback invoked as sink(query_index, value) for every
+     * intersection, where query_index is the position of the query in [b, e).
+     * For each query, values are reported in tree order; the reports of
+     * different queries are interleaved.
+     * @param group_size Number of queries in flight.
+     */
+    template < class Query_Iterator, class Sink >
+    void iintersect_interleaved(Query_Iterator b, Query_Iterator e, Sink sink, std::size_t group_size = 8) const
+    {
+        const_node_ptr root = Node_Traits::get_parent(this->header_ptr());
+        if (not root or b == e)
+        {
+            return;
+        }
+        auto node_sink = [&] (std::size_t q, const_node_ptr n) {
+            sink(q, *Value_Traits::to_value_ptr(n));
+        };
+        itree_algo::interleaved_intersect(root, b, std::size_t(std::distance(b, e)), group_size, node_sink);
+    }
+
+    /** Report all pairs of intersecting intervals between this tree and another.
+     * Both trees are traversed together, pruning pairs of subtrees by max_end,
+     * which takes fewer node visits than querying the other tree once for
+     * every interval in this one.
+     * @param other Interval tree, possibly of a different type, with
+     * comparable keys.
+     * @param sink Callback invoked as sink(value, other_value) for every
+     * intersecting pair, in no particular order.
+     */
+    template < class Other_ITree, class Sink >
+    void overlap_join(const Other_ITree& other, Sink&& sink) const
+    {
+        typedef typename Other_ITree::itree_algo other_itree_algo;
+        typedef typename Other_ITree::value_traits other_value_traits;
+        typedef typename Other_ITree::const_node_ptr other_const_node_ptr;
+        auto node_sink = [&] (const_node_ptr a, other_const_node_ptr b) {
+            sink(*Value_Traits::to_value_ptr(a), *other_value_traits::to_value_ptr(b));
+        };
+        itree_algo::template overlap_join< other_itree_algo >(
+            Node_Traits::get_parent(this->header_ptr()), const_node_ptr(),
+            Other_ITree::Node_Traits::get_parent(other.header_ptr()), other_const_node_ptr(),
+            node_sink);
+    }
+
+    /** Insert a range of values, rebuilding the tree in one pass.
+     * The new values are stably sorted by interval start (the sort is skipped if
+     * the range is already sorted), merged with the values already in the tree,
+     * and linked into a balanced tree in linear time, without per-element
+     * rebalancing. Equal starts keep the order of multiset::insert().
+     * @param b Range begin.
+     * @param e Range end.
+     */
+    template < class Iterator >
+    void bulk_load(Iterator b, Iterator e)
+    {
+        std::vector< node_ptr > new_nodes;
+        for (; b != e; ++b)
+        {
+            new_nodes.push_back(Value_Traits::to_node_ptr(*b));
+        }
+        if (not std::is_sorted(new_nodes.begin(), new_nodes.end(), node_start_less))
+        {
+            std::stable_sort(new_nodes.begin(), new_nodes.end(), node_start_less);
+        }
+        std::vector< node_ptr > nodes;
+        nodes.reserve(this->size() + new_nodes.size());
+        for (auto& ref : *this)
+        {
+            nodes.push_back(Value_Traits::to_node_ptr(ref));
+        }
+        if (nodes.empty())
+        {
+            nodes.swap(new_nodes);
+        }
+        else
+        {
+            std::vector< node_ptr > old_nodes;
+            old_nodes.swap(nodes);
+            std::merge(old_nodes.begin(), old_nodes.end(), new_nodes.begin(), new_nodes.end(),
+                       std::back_inserter(nodes), node_start_less);
+        }
+        node_ptr header = this->header_ptr();
+        itree_algo::init_header(header);
+        itree_algo::build_from_sorted(header, nodes.begin(), nodes.size());
+        this->sz_traits().set_size(size_type(nodes.size()));
+    }
+
+    /** Count intervals with start <= key, in O(log n).
+     * Requires Node Traits get_count()/set_count().
+     */
+    size_type count_start_le(const key_type& key) const
+    {
+        return size_type(itree_algo::count_start_le(Node_Traits::get_parent(this->header_ptr()), key));
+    }
+
+    /** Count intervals with start < key, in O(log n).
+     * Requires Node Traits get_count()/set_count().
+     */
+    size_type count_start_lt(const key_type& key) const
+    {
+        return size_type(itree_algo::count_start_lt(Node_Traits::get_parent(this->header_ptr()), key));
+    }
+
+    /** Count intervals in the tree that intersect a given interval, in O(log n).
+     * An interval intersects [int_start, int_end] iff it starts at or before
+     * int_end and does not end before int_start. The second term needs an
+     * ordering on ends, which is provided by end_index: a second counting
+     * itree on the same intervals whose Value Traits get_start() returns the
+     * interval end. Both trees require Node Traits get_count()/set_count(),
+     * and all intervals must satisfy start <= end.
+     * NOTE: end_index is maintained by the caller, and the result is only
+     * valid if it holds exactly the intervals of this tree, with their current
+     * ends. Every change to this tree must be mirrored on end_index: insert()
+     * and erase(), update_end() (erase and reinsert there), split(), join(),
+     * union_with(), clone_from() and bulk_load() (rebuild), implement_shift()
+     * (which end_index needs as well), and shift_from() (erase and reinsert
+     * the shifted intervals, which are not contiguous in end order); only
+     * update_start() needs nothing. Debug builds assert that the sizes match
+     * and the counts are consistent. counting_itree keeps both trees in sync.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param end_index Tree of the same intervals, keyed by end.
+     */
+    template < class End_Index >
+    size_type iintersect_count(const key_type& int_start, const key_type& int_end,
+                               const End_Index& end_index) const
+    {
+        BOOST_ASSERT(size_type(end_index.size()) == this->size());
+        if (int_end < int_start)
+        {
+            return 0;
+        }
+        size_type n_start_le = count_start_le(int_end);
+        size_type n_end_lt = size_type(end_index.count_start_lt(int_start));
+        // intervals ending before int_start also start before it
+        BOOST_ASSERT(n_end_lt <= n_start_le);
+        return n_start_le - n_end_lt;
+    }
+
+    /** Snapshot the tree into an immutable, contiguous index.
+     * See frozen_itree; the snapshot refers to the elements of this tree.
+     */
+    frozen_type freeze() const
+    {
+        return frozen_type(this->begin(), this->end());
+    }
+
+    /** Query statistics, as selected by the itree_stats option.
+     * Updated by iintersect(), istab(), icontaining(), icontained_in() and
+     * for_each_intersection().
+     */
+    using detail::Stats_Holder< Stats >::stats;
+
+    /** Get maximum right endpoint is the tree.
+     * @return Max end of the root, or key_type() if the tree is empty.
+     */
     key_type max_end() const
     {
-        return Node_Traits::get_max_end(this->header_ptr());
+        const_node_ptr root = Node_Traits::get_parent(this->header_ptr());
+        return root ? Node_Traits::get_max_end(root) : key_type();
+    }
+
+    /** Aggregate of a policy over the whole tree, in O(1).
+     * Requires the policy among the itree_augment options.
+     * @return The aggregate, or Policy::identity() if the tree is empty.
+     */
+    template < class Policy >
+    typename Policy::value_type aggregate() const
+    {
+        const_node_ptr root = Node_Traits::get_parent(this->header_ptr());
+        return root ? Node_Traits::template get_aggregate< Policy >(root) : Policy::identity();
+    }
+
+    /** Aggregate of a policy over the intervals with start in [lo, hi], in O(log n).
+     * Requires the policy among the itree_augment options.
+     * @return The aggregate, or Policy::identity() if there are no such intervals.
+     */
+    template < class Policy >
+    typename Policy::value_type aggregate_start_range(const key_type& lo, const key_type& hi) const
+    {
+        return itree_algo::template aggregate_start_range< Policy >(Node_Traits::get_parent(this->header_ptr()), lo, hi);
+    }
+
+    /** Visit the intervals whose own aggregate satisfies a predicate.
+     * Requires the policy among the itree_augment options. Subtrees whose
+     * aggregate fails the predicate are skipped, so the predicate must fail
+     * on combine(a, b) only if it fails on both a and b.
+     * @param pred Callback invoked as pred(aggregate).
+     * @param visitor Callback invoked as visitor(value) in tree order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Policy, class Predicate, class Visitor >
+    bool for_each_if(Predicate&& pred, Visitor&& visitor) const
+    {
+        return itree_algo::template for_each_if< Policy >(
+            Node_Traits::get_parent(this->header_ptr()), pred,
+            [&] (const_node_ptr n) { return visitor(*Value_Traits::to_value_ptr(n)); });
+    }
+
+    /** Find the first interval, in tree order, that starts after a point.
+     * Takes O(log n).
+     * @param point Query point.
+     * @return Iterator to the interval, or end() if there is none.
+     */
+    const_iterator next_after(const key_type& point) const
+    {
+        return node_to_iterator(itree_algo::next_after(mutable_header_ptr(), point));
+    }
+
+    /** Find an interval with the largest end among those that end before a point.
+     * Takes O(log n + m), where m is the number of intervals containing the point.
+     * @param point Query point.
+     * @return Iterator to the interval, or end() if there is none.
+     */
+    const_iterator prev_before(const key_type& point) const
+    {
+        return node_to_iterator(itree_algo::prev_before(mutable_header_ptr(), point));
+    }
+
+    /** Find the k intervals closest to a point.
+     * The distance is 0 for intervals containing the point, and otherwise the
+     * distance to their nearest endpoint. Takes O(log n + m + k log n) in the
+     * worst case, where m is the number of intervals containing the point.
+     * @param point Query point.
+     * @param k Number of intervals to find.
+     * @param out Output iterator receiving pointers to at most k values, by
+     * increasing distance (in any order among equal distances).
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator nearest(const key_type& point, std::size_t k, Output_Iterator out) const
+    {
+        itree_algo::nearest(mutable_header_ptr(), point, k,
+                            [&] (node_ptr n) { *out++ = const_pointer(Value_Traits::to_value_ptr(n)); });
+        return out;
+    }
+
+    /** Change the end of an interval in place.
+     * Requires Value Traits set_end(pointer, key_type). No relinking or
+     * rebalancing is done: max_end is recomputed on the path to the root,
+     * stopping as soon as it is unchanged.
+     * @param it Iterator to the interval.
+     * @param new_end New interval end.
+     */
+    void update_end(iterator it, const key_type& new_end)
+    {
+        static_assert(detail::has_static_member_function_set_end< Value_Traits, void (pointer, key_type) >::value,
+                      "Value Traits missing set_end()");
+        node_ptr n = Value_Traits::to_node_ptr(*it);
+        key_type old_max_end = Node_Traits::get_max_end(n);
+        Value_Traits::set_end(Value_Traits::to_value_ptr(n), new_end);
+        itree_algo::propagate_max_end(this->header_ptr(), n, old_max_end);
+    }
+
+    /** Change the start of an interval.
+     * Requires Value Traits set_start(pointer, key_type). If the new start
+     * keeps the interval between its neighbours, it is updated in place;
+     * otherwise the interval is unlinked and reinserted.
+     * @param it Iterator to the interval.
+     * @param new_start New interval start.
+     * @return Iterator to the updated interval.
+     */
+    iterator update_start(iterator it, const key_type& new_start)
+    {
+        static_assert(detail::has_static_member_function_set_start< Value_Traits, void (pointer, key_type) >::value,
+                      "Value Traits missing set_start()");
+        pointer p = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(*it));
+        iterator prev = it;
+        iterator next = it;
+        ++next;
+        if ((it == this->begin() or not (new_start < Value_Traits::get_start(&*--prev)))
+            and (next == this->end() or not (Value_Traits::get_start(&*next) < new_start)))
+        {
+            // max_end does not depend on starts, but other aggregates may
+            Value_Traits::set_start(p, new_start);
+            if (Node_Traits::has_augment)
+            {
+                itree_algo::recompute_path(this->header_ptr(), Value_Traits::to_node_ptr(*p));
+            }
+            return it;
+        }
+        this->erase(it);
+        Value_Traits::set_start(p, new_start);
+        return this->insert(*p);
+    }
+
+    /** Move the intervals with start >= key to another tree.
+     * Takes O(log n) if the Node Traits provide subtree counts, or without
+     * constant-time size; otherwise, counting the intervals moved to right
+     * takes O(n). The tree itself is cut by red-black split, in O(log n).
+     * @param key Split key.
+     * @param right Empty tree receiving the intervals starting at or after key.
+     * @throw std::invalid_argument if right is not empty; neither tree is modified.
+     */
+    void split(const key_type& key, itree_impl& right)
+    {
+        if (not right.empty())
+        {
+            throw std::invalid_argument("itree::split: right tree is not empty");
+        }
+        node_ptr header = this->header_ptr();
+        node_ptr root = Node_Traits::get_parent(header);
+        node_ptr l;
+        node_ptr r;
+        std::size_t bh_l;
+        std::size_t bh_r;
+        itree_algo::split(root, itree_algo::black_height(root), key, l, bh_l, r, bh_r);
+        itree_algo::set_root(header, l);
+        itree_algo::set_root(right.header_ptr(), r);
+        size_type right_size = right.tree_size(std::integral_constant< bool, Node_Traits::has_count >());
+        right.sz_traits().set_size(right_size);
+        this->sz_traits().set_size(this->sz_traits().get_size() - right_size);
+    }
+
+    /** Move all intervals of another tree to the end of this one.
+     * Uses red-black join, in O(log n).
+     * @param right Tree whose starts are all >= the starts in this tree; it
+     * is left empty. Joining a tree with itself does nothing.
+     */
+    void join(itree_impl& right)
+    {
+        if (&right == this or right.empty())
+        {
+            return;
+        }
+        BOOST_ASSERT(this->empty()
+                     or not (Value_Traits::get_start(&*right.begin()) < Value_Traits::get_start(&*this->rbegin())));
+        node_ptr header = this->header_ptr();
+        node_ptr r = Node_Traits::get_parent(right.header_ptr());
+        size_type total_size = this->sz_traits().get_size() + right.sz_traits().get_size();
+        node_ptr root = r;
+        if (not this->empty())
+        {
+            // the last interval of this tree becomes the middle node of the join
+            node_ptr k = Node_Traits::get_right(header);
+            itree_algo::erase(header, k);
+            node_ptr l = Node_Traits::get_parent(header);
+            std::size_t bh;
+            root = itree_algo::join3(l, itree_algo::black_height(l), k, r, itree_algo::black_height(r), bh);
+        }
+        itree_algo::set_root(header, root);
+        itree_algo::init_header(right.header_ptr());
+        this->sz_traits().set_size(total_size);
+        right.sz_traits().set_size(0);
+    }
+
+    /** Move all intervals of another tree into this one.
+     * The key ranges may overlap. Uses red-black split and join, in
+     * O(m log(n / m + 1)) for tree sizes m <= n.
+     * @param other Tree that is left empty; the union of a tree with itself
+     * does nothing.
+     */
+    void union_with(itree_impl& other)
+    {
+        if (&other == this)
+        {
+            return;
+        }
+        node_ptr header = this->header_ptr();
+        node_ptr a = Node_Traits::get_parent(header);
+        node_ptr b = Node_Traits::get_parent(other.header_ptr());
+        size_type total_size = this->sz_traits().get_size() + other.sz_traits().get_size();
+        std::size_t bh;
+        node_ptr root = itree_algo::union_trees(a, itree_algo::black_height(a), b, itree_algo::black_height(b), bh);
+        itree_algo::set_root(header, root);
+        itree_algo::init_header(other.header_ptr());
+        this->sz_traits().set_size(total_size);
+        other.sz_traits().set_size(0);
     }
 
     /** Inform interval tree of an external shift in all interval endpoints.
      * NOTE: This function shifts the internal data stored in the interval tree,
-     * but not the elements (intervals) themselves.
+     * but not the elements (intervals) themselves: the caller shifts both
+     * endpoints of every element by delta, either before or after this call,
+     * and does not query the tree in between.
+     * With integral keys, max_end values are stored relative to node ends, so
+     * there is nothing to update: this takes O(1), and aggregates of
+     * itree_augment policies that depend on absolute positions, such as
+     * itree_min_start_augment, become stale. With other keys, delta is added
+     * to the max_end (and min_end) of every node, in O(n).
      * @param delta Value to add to all endpoints.
      */
     template < typename delta_type >
     void implement_shift(delta_type delta)
     {
-        for (auto ref : *this)
+        implement_shift(delta, typename Node_Traits::relative_ends_type());
+    }
+
+    /** Inform interval tree of an external shift of the intervals starting at or after a position.
+     * NOTE: Unlike implement_shift(), the elements must be shifted beforehand:
+     * both endpoints of every interval with start >= pos were shifted by delta,
+     * and the other intervals were left in place. If delta is negative, no
+     * interval left in place may start at or after pos + delta, so that tree
+     * order is preserved. Only the nodes whose subtree holds both shifted and
+     * unshifted intervals need updating; these lie on the paths to the two
+     * intervals around pos, so this takes O(log n) with integral keys. As with
+     * implement_shift(), aggregates that depend on absolute positions become
+     * stale. With other keys, all nodes are recomputed, in O(n).
+     * @param pos Position of the shift, before it was applied.
+     * @param delta Value added to the endpoints of the shifted intervals.
+     */
+    template < typename delta_type >
+    void shift_from(const key_type& pos, delta_type delta)
+    {
+        node_ptr header = this->header_ptr();
+        if (not Node_Traits::get_parent(header))
+        {
+            return;
+        }
+        if (not Node_Traits::relative_ends)
+        {
+            itree_algo::recompute_subtree(Node_Traits::get_parent(header));
+            return;
+        }
+        node_ptr first_shifted = itree_algo::lower_bound_start(header, key_type(delta_type(pos) + delta));
+        node_ptr last_unshifted = (first_shifted == Node_Traits::get_left(header)
+                                   ? header : itree_algo::prev_node(first_shifted));
+        if (first_shifted != header)
         {
-            node_ptr n = &ref;
-            Node_Traits::set_max_end(n, key_type(delta_type(Node_Traits::get_max_end(n)) + delta));
+            itree_algo::recompute_path(header, first_shifted);
+        }
+        if (last_unshifted != header)
+        {
+            itree_algo::recompute_path(header, last_unshifted);
         }
     }
 
 private:
+    // overlap_join() reads the root of trees of other types
+    template < class, class, class, bool, class > friend class itree_impl;
+
+    template < typename delta_type >
+    void implement_shift(delta_type, std::true_type)
+    {
+    }
+    template < typename delta_type >
+    void implement_shift(delta_type delta, std::false_type)
+    {
+        itree_algo::shift_subtree(Node_Traits::get_parent(this->header_ptr()), delta);
+    }
+
+    size_type tree_size(std::true_type) const
+    {
+        const_node_ptr root = Node_Traits::get_parent(this->header_ptr());
+        return root ? size_type(Node_Traits::get_count(root)) : size_type(0);
+    }
+    size_type tree_size(std::false_type) const
+    {
+        return Constant_Time_Size ? size_type(std::distance(this->begin(), this->end())) : size_type(0);
+    }
+
+    static bool node_start_less(const_node_ptr lhs, const_node_ptr rhs)
+    {
+        return Value_Traits::get_start(Value_Traits::to_value_ptr(lhs))
+            < Value_Traits::get_start(Value_Traits::to_value_ptr(rhs));
+    }
+
+    node_ptr mutable_header_ptr() const
+    {
+        return pointer_traits< node_ptr >::const_cast_from(this->header_ptr());
+    }
+    const_iterator node_to_iterator(node_ptr n) const
+    {
+        return n == mutable_header_ptr() ? this->end() : this->iterator_to(*Value_Traits::to_value_ptr(n));
+    }
+
     intersection_const_iterator iintersect_begin(const key_type& int_start, const key_type& int_end) const
     {
         const_node_ptr header = this->header_ptr();
+        stats().begin_query();
         if (not Node_Traits::get_parent(header))
         {
             return iintersect_end();
         }
         return intersection_const_iterator(
-            itree_algo::get_next_interval(int_start, int_end, Node_Traits::get_parent(header), 0),
-            int_start, int_end);
+            itree_algo::get_next_interval(int_start, int_end, Node_Traits::get_parent(header), 0, stats()),
+            typename itree_algo::template Intersection_Query< Stats >(int_start, int_end, &stats()));
     }
     intersection_const_iterator iintersect_end() const
     {
         const_node_ptr header = this->header_ptr();
         return intersection_const_iterator(header);
     }
+    stab_const_iterator istab_begin(const key_type& point) const
+    {
+        const_node_ptr header = this->header_ptr();
+        const_node_ptr root = Node_Traits::get_parent(header);
+        stats().begin_query();
+        if (not root)
+        {
+            return stab_const_iterator(header);
+        }
+        if (Node_Traits::get_max_end(root) < point)
+        {
+            stats().prune();
+            return stab_const_iterator(header);
+        }
+        return stab_const_iterator(itree_algo::get_next_stab(point, root, 0, stats()),
+                                   typename itree_algo::template Stab_Query< Stats >(point, &stats()));
+    }
+    template < class Query_Const_Iterator, class Query >
+    Query_Const_Iterator query_begin(const Query& query) const
+    {
+        const_node_ptr header = this->header_ptr();
+        const_node_ptr root = Node_Traits::get_parent(header);
+        stats().begin_query();
+        if (not root)
+        {
+            return Query_Const_Iterator(header);
+        }
+        if (not query.possible_in_stree(root))
+        {
+            stats().prune();
+            return Query_Const_Iterator(header);
+        }
+        return Query_Const_Iterator(query.get_next(root, 0), query);
+    }
 }; // class itree_impl
 
 template < class T, class ...Options >
 struct make_itree
 {
-    typedef typename pack_options< rbtree_defaults, Options... >::type packed_options;
+    typedef typename pack_options< itree_defaults, Options... >::type packed_options;
     typedef typename detail::get_value_traits< T, typename packed_options::proto_value_traits >::type value_traits;
-    typedef itree_impl< detail::ITree_Value_Traits< value_traits >
+    typedef itree_impl< detail::ITree_Value_Traits< value_traits, typename packed_options::augment_type >
                       , detail::ITree_Compare< value_traits >
                       , typename packed_options::size_type
                       , packed_options::constant_time_size
+                      , typename packed_options::stats_type
                       > type;
 }; // class make_itree
 
@@ -305,7 +1186,7 @@ public:
     itree(Iterator b, Iterator e,
           const value_compare& cmp = value_compare(),
           const value_traits& v_traits = value_traits())
-        : Base(false, b, e, cmp, v_traits)
+        : Base(b, e, cmp, v_traits)
     {}
 
     itree(itree&& other)
@@ -326,6 +1207,15 @@ public:
     { return static_cast< const itree& >(Base::container_from_iterator(it)); }
 }; // class itree
 
+/** Report all pairs of intersecting intervals between two interval trees.
+ * @see itree_impl::overlap_join()
+ */
+template < class ITree_A, class ITree_B, class Sink >
+void overlap_join(const ITree_A& tree_a, const ITree_B& tree_b, Sink&& sink)
+{
+    tree_a.overlap_join(tree_b, std::forward< Sink >(sink));
+}
+
 } // namespace intrusive
 } // namespace boost
 
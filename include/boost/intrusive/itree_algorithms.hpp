@@ -1,7 +1,15 @@
 #ifndef __ITREE_ALGORTIHMS_HPP
 #define __ITREE_ALGORTIHMS_HPP
 
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <queue>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 #include <boost/intrusive/rbtree_algorithms.hpp>
+#include "itree_stats.hpp"
 
 
 namespace boost
@@ -12,6 +20,7 @@ namespace intrusive
 template <typename Value_Traits>
 struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_traits >
 {
+    typedef Value_Traits value_traits;
     typedef typename Value_Traits::node_traits Node_Traits;
     typedef typename Value_Traits::key_type key_type;
     typedef typename Node_Traits::node_ptr node_ptr;
@@ -41,8 +50,44 @@ struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_
 
     static node_ptr get_next_interval(
         const key_type& int_start, const key_type& int_end, const_node_ptr _n, int stage)
+    {
+        null_itree_stats stats;
+        return get_next_interval(int_start, int_end, _n, stage, stats);
+    }
+
+    /** Find the next interval intersecting [int_start, int_end].
+     * @param stats Query statistics policy, notified of traversal events.
+     */
+    template < typename Stats >
+    static node_ptr get_next_interval(
+        const key_type& int_start, const key_type& int_end, const_node_ptr _n, int stage, Stats& stats)
     {
         node_ptr n = pointer_traits< node_ptr >::const_cast_from(_n);
+        while (interval_step(int_start, int_end, n, stage, stats) == step_descend)
+        {}
+        return n;
+    }
+
+    /** Outcome of interval_step(). */
+    enum step_result
+    {
+        step_report,    // n intersects the interval; resume at stage 2
+        step_descend,   // n moved to a child, at stage 0
+        step_end        // traversal done; n is the header
+    };
+
+    /** Run the traversal of get_next_interval() up to its next memory access.
+     * The stage machine runs until it reports a node, moves to a child (which
+     * is likely not in cache), or ends. Climbs to a parent do not stop it,
+     * since the parent was visited on the way down.
+     * @param n Current node, updated.
+     * @param stage Traversal stage, as in get_next_interval(), updated.
+     * @param stats Query statistics policy, notified of traversal events.
+     */
+    template < typename Stats >
+    static step_result interval_step(
+        const key_type& int_start, const key_type& int_end, node_ptr& n, int& stage, Stats& stats)
+    {
         while (true)
         {
             if (not n)
@@ -52,13 +97,19 @@ struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_
             if (stage == 0)
             {
                 // arrived from parent; try left stree
+                stats.visit();
                 if (possible_intersection_in_left_stree(int_start, int_end, n) and Node_Traits::get_left(n))
                 {
                     n = Node_Traits::get_left(n);
                     stage = 0;
+                    return step_descend;
                 }
                 else
                 {
+                    if (Node_Traits::get_left(n))
+                    {
+                        stats.prune();
+                    }
                     stage = 1;
                 }
             }
@@ -67,7 +118,9 @@ struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_
                 // finished visiting left stree; try current node
                 if (intersect_node(int_start, int_end, n))
                 {
-                    return n;
+                    stats.report();
+                    stage = 2;
+                    return step_report;
                 }
                 else
                 {
@@ -81,13 +134,128 @@ struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_
                 {
                     n = Node_Traits::get_right(n);
                     stage = 0;
+                    return step_descend;
                 }
                 else
                 {
+                    if (Node_Traits::get_right(n))
+                    {
+                        stats.prune();
+                    }
                     stage = 3;
                 }
             }
             else if (stage == 3)
+            {
+                // finished visiting right stree
+                node_ptr p = Node_Traits::get_parent(n);
+                if (Node_Traits::get_parent(p) == n)
+                {
+                    // p is the header; we are done
+                    n = p;
+                    return step_end;
+                }
+                stats.climb();
+                if (Node_Traits::get_left(p) == n)
+                {
+                    // n is left child
+                    n = p;
+                    stage = 1;
+                }
+                else
+                {
+                    // n is right child
+                    n = p;
+                    stage = 3;
+                }
+            }
+        }
+    }
+
+    /** Find the next interval containing a point.
+     * Same traversal as get_next_interval() for [point, point], with
+     * one-sided tests: a child is entered only if its max_end reaches the
+     * point, and the right subtree is pruned as soon as a node starts after
+     * the point.
+     * @param point Query point.
+     * @param _n Current node; when stage is 0, point <= max_end of _n.
+     * @param stage Traversal stage, as in get_next_interval().
+     * @return Next node containing the point, or the header.
+     */
+    static node_ptr get_next_stab(const key_type& point, const_node_ptr _n, int stage)
+    {
+        null_itree_stats stats;
+        return get_next_stab(point, _n, stage, stats);
+    }
+
+    /** Find the next interval containing a point.
+     * @param stats Query statistics policy, notified of traversal events.
+     */
+    template < typename Stats >
+    static node_ptr get_next_stab(const key_type& point, const_node_ptr _n, int stage, Stats& stats)
+    {
+        node_ptr n = pointer_traits< node_ptr >::const_cast_from(_n);
+        while (true)
+        {
+            if (stage == 0)
+            {
+                // arrived from parent; try left stree
+                stats.visit();
+                node_ptr l = Node_Traits::get_left(n);
+                if (l and not (Node_Traits::get_max_end(l) < point))
+                {
+                    n = l;
+                }
+                else
+                {
+                    if (l)
+                    {
+                        stats.prune();
+                    }
+                    stage = 1;
+                }
+            }
+            else if (stage == 1)
+            {
+                // finished visiting left stree; try current node
+                if (point < Value_Traits::get_start(Value_Traits::to_value_ptr(n)))
+                {
+                    // n and its right stree start after the point
+                    if (Node_Traits::get_right(n))
+                    {
+                        stats.prune();
+                    }
+                    stage = 3;
+                }
+                else if (not (Value_Traits::get_end(Value_Traits::to_value_ptr(n)) < point))
+                {
+                    stats.report();
+                    return n;
+                }
+                else
+                {
+                    stage = 2;
+                }
+            }
+            else if (stage == 2)
+            {
+                // visited current node; try right stree
+                node_ptr r = Node_Traits::get_right(n);
+                if (r and not (Node_Traits::get_max_end(r) < point))
+                {
+                    n = r;
+                    stage = 0;
+                }
+                else
+                {
+                    if (r)
+                    {
+                        stats.prune();
+                    }
+                    stage = 3;
+                }
+            }
+            else
             {
                 // finished visiting right stree
                 node_ptr p = Node_Traits::get_parent(n);
@@ -96,7 +264,8 @@ struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_
                     // p is the header; we are done
                     return p;
                 }
-                else if (Node_Traits::get_left(p) == n)
+                stats.climb();
+                if (Node_Traits::get_left(p) == n)
                 {
                     // n is left child
                     n = p;
@@ -106,10 +275,1250 @@ struct itree_algorithms : public rbtree_algorithms< typename Value_Traits::node_
                 {
                     // n is right child
                     n = p;
+                }
+            }
+        }
+    }
+
+    /** Visit the intervals in a subtree that intersect [int_start, int_end].
+     * Pruned in-order traversal done in a single pass, using an explicit
+     * stack of the nodes whose left subtree is being visited; no parent
+     * pointers are followed. The traversal stops at the first node starting
+     * after int_end. Intervals are assumed to satisfy start <= end.
+     * @param root Subtree root (may be null).
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(node) for every
+     * intersecting node, in tree order; returning false stops the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < typename Visitor >
+    static bool for_each_intersection(const_node_ptr root, const key_type& int_start, const key_type& int_end,
+                                      Visitor&& visitor)
+    {
+        null_itree_stats stats;
+        return for_each_intersection(root, int_start, int_end, visitor, stats);
+    }
+
+    /** Visit the intervals in a subtree that intersect [int_start, int_end].
+     * @param stats Query statistics policy, notified of traversal events;
+     * returns to a node saved on the stack are reported as climbs.
+     */
+    template < typename Visitor, typename Stats >
+    static bool for_each_intersection(const_node_ptr root, const key_type& int_start, const key_type& int_end,
+                                      Visitor&& visitor, Stats& stats)
+    {
+        // red-black tree height is at most 2 log2(n + 1)
+        node_ptr stack[2 * CHAR_BIT * sizeof(std::size_t)];
+        std::size_t depth = 0;
+        node_ptr n = pointer_traits< node_ptr >::const_cast_from(root);
+        if (not n)
+        {
+            return true;
+        }
+        if (Node_Traits::get_max_end(n) < int_start)
+        {
+            stats.prune();
+            return true;
+        }
+        while (true)
+        {
+            // descend into left strees that can intersect
+            stats.visit();
+            node_ptr l;
+            for (l = Node_Traits::get_left(n);
+                 l and not (Node_Traits::get_max_end(l) < int_start);
+                 l = Node_Traits::get_left(n))
+            {
+                stack[depth++] = n;
+                n = l;
+                stats.visit();
+            }
+            if (l)
+            {
+                stats.prune();
+            }
+            while (true)
+            {
+                if (int_end < Value_Traits::get_start(Value_Traits::to_value_ptr(n)))
+                {
+                    // this and all remaining nodes start after the interval
+                    stats.prune();
+                    return true;
+                }
+                if (not (Value_Traits::get_end(Value_Traits::to_value_ptr(n)) < int_start))
+                {
+                    stats.report();
+                    if (not visitor(n))
+                    {
+                        return false;
+                    }
+                }
+                node_ptr r = Node_Traits::get_right(n);
+                if (r and not (Node_Traits::get_max_end(r) < int_start))
+                {
+                    n = r;
+                    break;
+                }
+                if (r)
+                {
+                    stats.prune();
+                }
+                if (depth == 0)
+                {
+                    return true;
+                }
+                n = stack[--depth];
+                stats.climb();
+            }
+        }
+    }
+
+    /** Query policy for Query_Iterator: intervals intersecting [int_start, int_end].
+     * Holds a reference to the statistics of the tree, if any.
+     */
+    template < typename Stats = null_itree_stats >
+    struct Intersection_Query : public detail::Stats_Ref< Stats >
+    {
+        Intersection_Query(const key_type& _int_start = key_type(), const key_type& _int_end = key_type(),
+                           Stats* stats = nullptr)
+            : detail::Stats_Ref< Stats >(stats), int_start(_int_start), int_end(_int_end) {}
+        node_ptr get_next(const_node_ptr n, int stage) const
+        {
+            return get_next_interval(int_start, int_end, n, stage, this->stats());
+        }
+        key_type int_start;
+        key_type int_end;
+    };
+
+    /** Query policy for Query_Iterator: intervals containing point. */
+    template < typename Stats = null_itree_stats >
+    struct Stab_Query : public detail::Stats_Ref< Stats >
+    {
+        Stab_Query(const key_type& _point = key_type(), Stats* stats = nullptr)
+            : detail::Stats_Ref< Stats >(stats), point(_point) {}
+        node_ptr get_next(const_node_ptr n, int stage) const
+        {
+            return get_next_stab(point, n, stage, this->stats());
+        }
+        key_type point;
+    };
+
+    static bool contains_node(
+        const key_type& int_start, const key_type& int_end, const_node_ptr n)
+    {
+        return (not (int_start < Value_Traits::get_start(Value_Traits::to_value_ptr(n)))
+                and not (Value_Traits::get_end(Value_Traits::to_value_ptr(n)) < int_end));
+    }
+
+    static bool possible_containing_in_stree(
+        const key_type&, const key_type& int_end, const_node_ptr n)
+    {
+        return not (Node_Traits::get_max_end(n) < int_end);
+    }
+
+    static bool contained_in_node(
+        const key_type& int_start, const key_type& int_end, const_node_ptr n)
+    {
+        return (not (Value_Traits::get_start(Value_Traits::to_value_ptr(n)) < int_start)
+                and not (int_end < Value_Traits::get_end(Value_Traits::to_value_ptr(n))));
+    }
+
+    /** Subtree n may hold intervals within [int_start, int_end].
+     * Uses the subtree min_end, if maintained.
+     */
+    static bool possible_contained_in_stree(
+        const key_type& int_start, const key_type& int_end, const_node_ptr n)
+    {
+        return (not (Node_Traits::get_max_end(n) < int_start)
+                and min_end_at_most(n, int_end, std::integral_constant< bool, Node_Traits::has_min_end >()));
+    }
+
+    /** Find the next node matching a query.
+     * Same traversal as get_next_stab(), driven by the predicates of the query:
+     * - query.possible_in_stree(n): subtree n may hold matches, from its
+     *   max_end (and min_end);
+     * - query.possible_in_left_stree(n): the left subtree of n may hold
+     *   matches, from the start of n;
+     * - query.past(n): n and its right subtree start too late to match;
+     * - query.match(n): n matches.
+     * @param _n Current node; when stage is 0, query.possible_in_stree(_n).
+     * @param stage Traversal stage, as in get_next_interval().
+     * @return Next matching node, or the header.
+     */
+    template < typename Query, typename Stats >
+    static node_ptr get_next_match(const Query& query, const_node_ptr _n, int stage, Stats& stats)
+    {
+        node_ptr n = pointer_traits< node_ptr >::const_cast_from(_n);
+        while (true)
+        {
+            if (stage == 0)
+            {
+                // arrived from parent; try left stree
+                stats.visit();
+                node_ptr l = Node_Traits::get_left(n);
+                if (l and query.possible_in_left_stree(n) and query.possible_in_stree(l))
+                {
+                    n = l;
+                }
+                else
+                {
+                    if (l)
+                    {
+                        stats.prune();
+                    }
+                    stage = 1;
+                }
+            }
+            else if (stage == 1)
+            {
+                // finished visiting left stree; try current node
+                if (query.past(n))
+                {
+                    if (Node_Traits::get_right(n))
+                    {
+                        stats.prune();
+                    }
+                    stage = 3;
+                }
+                else if (query.match(n))
+                {
+                    stats.report();
+                    return n;
+                }
+                else
+                {
+                    stage = 2;
+                }
+            }
+            else if (stage == 2)
+            {
+                // visited current node; try right stree
+                node_ptr r = Node_Traits::get_right(n);
+                if (r and query.possible_in_stree(r))
+                {
+                    n = r;
+                    stage = 0;
+                }
+                else
+                {
+                    if (r)
+                    {
+                        stats.prune();
+                    }
                     stage = 3;
                 }
             }
+            else
+            {
+                // finished visiting right stree
+                node_ptr p = Node_Traits::get_parent(n);
+                if (Node_Traits::get_parent(p) == n)
+                {
+                    // p is the header; we are done
+                    return p;
+                }
+                stats.climb();
+                if (Node_Traits::get_left(p) == n)
+                {
+                    // n is left child
+                    n = p;
+                    stage = 1;
+                }
+                else
+                {
+                    // n is right child
+                    n = p;
+                }
+            }
+        }
+    }
+
+    /** Query policy for Query_Iterator: intervals containing [int_start, int_end].
+     * Subtrees are pruned by max_end, and nodes starting after int_start end
+     * the traversal of their subtree.
+     */
+    template < typename Stats = null_itree_stats >
+    struct Containing_Query : public detail::Stats_Ref< Stats >
+    {
+        Containing_Query(const key_type& _int_start = key_type(), const key_type& _int_end = key_type(),
+                         Stats* stats = nullptr)
+            : detail::Stats_Ref< Stats >(stats), int_start(_int_start), int_end(_int_end) {}
+        node_ptr get_next(const_node_ptr n, int stage) const
+        {
+            return get_next_match(*this, n, stage, this->stats());
+        }
+        bool possible_in_stree(const_node_ptr n) const { return possible_containing_in_stree(int_start, int_end, n); }
+        bool possible_in_left_stree(const_node_ptr) const { return true; }
+        bool past(const_node_ptr n) const { return int_start < Value_Traits::get_start(Value_Traits::to_value_ptr(n)); }
+        bool match(const_node_ptr n) const { return contains_node(int_start, int_end, n); }
+        key_type int_start;
+        key_type int_end;
+    };
+
+    /** Query policy for Query_Iterator: intervals contained in [int_start, int_end].
+     * Only subtrees with starts in [int_start, int_end] are visited; with
+     * subtree min_end, those whose intervals all end after int_end are pruned.
+     */
+    template < typename Stats = null_itree_stats >
+    struct Contained_In_Query : public detail::Stats_Ref< Stats >
+    {
+        Contained_In_Query(const key_type& _int_start = key_type(), const key_type& _int_end = key_type(),
+                           Stats* stats = nullptr)
+            : detail::Stats_Ref< Stats >(stats), int_start(_int_start), int_end(_int_end) {}
+        node_ptr get_next(const_node_ptr n, int stage) const
+        {
+            return get_next_match(*this, n, stage, this->stats());
+        }
+        bool possible_in_stree(const_node_ptr n) const { return possible_contained_in_stree(int_start, int_end, n); }
+        bool possible_in_left_stree(const_node_ptr n) const
+        {
+            return not (Value_Traits::get_start(Value_Traits::to_value_ptr(n)) < int_start);
+        }
+        bool past(const_node_ptr n) const { return int_end < Value_Traits::get_start(Value_Traits::to_value_ptr(n)); }
+        bool match(const_node_ptr n) const { return contained_in_node(int_start, int_end, n); }
+        key_type int_start;
+        key_type int_end;
+    };
+
+    /** Count nodes with start <= key (or < key, if strict) in a subtree.
+     * Requires subtree counts (Node Traits get_count()).
+     */
+    static std::size_t count_start_le(const_node_ptr n, const key_type& key, bool strict = false)
+    {
+        static_assert(Node_Traits::has_count, "Node Traits missing get_count()/set_count()");
+        std::size_t res = 0;
+        while (n)
+        {
+            key_type n_start = Value_Traits::get_start(Value_Traits::to_value_ptr(n));
+            if (strict ? n_start < key : not (key < n_start))
+            {
+                res += 1 + (Node_Traits::get_left(n) ? Node_Traits::get_count(Node_Traits::get_left(n)) : 0);
+                n = Node_Traits::get_right(n);
+            }
+            else
+            {
+                n = Node_Traits::get_left(n);
+            }
+        }
+        return res;
+    }
+
+    static std::size_t count_start_lt(const_node_ptr n, const key_type& key)
+    {
+        return count_start_le(n, key, true);
+    }
+
+    /** Answer a batch of intersection queries in one traversal.
+     * Each node is visited once for all queries that might intersect its
+     * subtree: the queries for the left subtree are a prefix of the current
+     * ones (they are sorted by start), those for the right subtree are
+     * filtered into the free space at the end of idx. For each query,
+     * intersecting nodes are reported in tree order.
+     * @param n Subtree root.
+     * @param queries Random access iterator to queries (pairs of start, end).
+     * @param idx Query indices; idx[lo..hi) are sorted by start, and all have
+     * start <= max_end of n.
+     * @param lo Start of query indices.
+     * @param hi End of query indices.
+     * @param sink Callback invoked as sink(query_index, node).
+     */
+    template < typename Query_Iterator, typename Sink >
+    static void batch_intersect(const_node_ptr n, Query_Iterator queries,
+                                std::vector< std::size_t >& idx, std::size_t lo, std::size_t hi,
+                                Sink& sink)
+    {
+        node_ptr l = Node_Traits::get_left(n);
+        if (l)
+        {
+            key_type l_max_end = Node_Traits::get_max_end(l);
+            std::size_t mid = lo;
+            while (mid < hi and queries[idx[mid]].first <= l_max_end)
+            {
+                ++mid;
+            }
+            if (mid > lo)
+            {
+                batch_intersect(l, queries, idx, lo, mid, sink);
+            }
+        }
+        node_ptr r = Node_Traits::get_right(n);
+        std::size_t r_lo = idx.size();
+        key_type n_start = Value_Traits::get_start(Value_Traits::to_value_ptr(n));
+        for (std::size_t i = lo; i < hi; ++i)
+        {
+            std::size_t q = idx[i];
+            if (queries[q].second < n_start)
+            {
+                // neither n nor its right subtree can intersect q
+                continue;
+            }
+            if (intersect_node(queries[q].first, queries[q].second, n))
+            {
+                sink(q, n);
+            }
+            if (r and queries[q].first <= Node_Traits::get_max_end(r))
+            {
+                idx.push_back(q);
+            }
+        }
+        if (idx.size() > r_lo)
+        {
+            batch_intersect(r, queries, idx, r_lo, idx.size(), sink);
+            idx.resize(r_lo);
+        }
+    }
+
+    /** Answer a batch of intersection queries with interleaved traversals.
+     * Up to group_size queries are in flight, each as the state (node, stage)
+     * of the traversal of get_next_interval(). The queries take turns: each
+     * runs with interval_step() until it moves to a child node, whose cache
+     * lines are then prefetched while the other queries run. When a query
+     * ends, its slot takes the next query. For each query, intersecting nodes
+     * are reported in tree order; reports of different queries interleave.
+     * @param root Tree root (not null).
+     * @param queries Random access iterator to queries (pairs of start, end).
+     * @param n_queries Number of queries.
+     * @param group_size Number of queries in flight.
+     * @param sink Callback invoked as sink(query_index, node).
+     */
+    template < typename Query_Iterator, typename Sink >
+    static void interleaved_intersect(const_node_ptr root, Query_Iterator queries, std::size_t n_queries,
+                                      std::size_t group_size, Sink& sink)
+    {
+        struct Lane
+        {
+            std::size_t q;
+            node_ptr n;
+            int stage;
+        };
+        std::vector< Lane > lanes(std::max< std::size_t >(group_size, 1));
+        key_type root_max_end = Node_Traits::get_max_end(root);
+        std::size_t next_q = 0;
+        // give a slot the next query that can intersect anything
+        auto start_lane = [&] (Lane& lane) {
+            for (; next_q < n_queries; ++next_q)
+            {
+                if (not (root_max_end < queries[next_q].first))
+                {
+                    lane.q = next_q++;
+                    lane.n = pointer_traits< node_ptr >::const_cast_from(root);
+                    lane.stage = 0;
+                    return true;
+                }
+            }
+            return false;
+        };
+        std::size_t n_active = 0;
+        while (n_active < lanes.size() and start_lane(lanes[n_active]))
+        {
+            ++n_active;
+        }
+        null_itree_stats stats;
+        while (n_active > 0)
+        {
+            for (std::size_t i = 0; i < n_active; )
+            {
+                Lane& lane = lanes[i];
+                const key_type& int_start = queries[lane.q].first;
+                const key_type& int_end = queries[lane.q].second;
+                step_result res;
+                while ((res = interval_step(int_start, int_end, lane.n, lane.stage, stats)) == step_report)
+                {
+                    sink(lane.q, lane.n);
+                }
+                if (res == step_descend)
+                {
+                    prefetch_node(lane.n);
+                    ++i;
+                }
+                else if (start_lane(lane))
+                {
+                    ++i;
+                }
+                else
+                {
+                    lane = lanes[--n_active];
+                }
+            }
+        }
+    }
+
+    /** Report all pairs of intersecting intervals between two subtrees.
+     * The subtrees are traversed together: for a pair of subtrees (a, b), the
+     * root of a is matched against b, the root of b against the children of a,
+     * and the four pairs of children are processed recursively. A pair is
+     * pruned when one side ends before the other can start, using the max_end
+     * of one side and a lower bound on the starts of the other, so each
+     * descent is shared by all the intervals of a subtree.
+     * Every intersecting pair is reported exactly once, in no particular order.
+     * @param a Subtree root in a tree of this type.
+     * @param a_lo Node whose start bounds all starts in a from below, or null.
+     * @param b Subtree root in a tree handled by Other_Algorithms.
+     * @param b_lo Node whose start bounds all starts in b from below, or null.
+     * @param sink Callback invoked as sink(node_a, node_b).
+     */
+    template < typename Other_Algorithms, typename Sink >
+    static void overlap_join(const_node_ptr a, const_node_ptr a_lo,
+                             typename Other_Algorithms::const_node_ptr b,
+                             typename Other_Algorithms::const_node_ptr b_lo,
+                             Sink& sink)
+    {
+        typedef typename Other_Algorithms::Node_Traits Other_Node_Traits;
+        typedef typename Other_Algorithms::value_traits Other_Value_Traits;
+        typedef typename Other_Algorithms::const_node_ptr other_const_node_ptr;
+        if (not a or not b
+            or (b_lo and Node_Traits::get_max_end(a) < Other_Value_Traits::get_start(Other_Value_Traits::to_value_ptr(b_lo)))
+            or (a_lo and Other_Node_Traits::get_max_end(b) < Value_Traits::get_start(Value_Traits::to_value_ptr(a_lo))))
+        {
+            return;
+        }
+        key_type a_start = Value_Traits::get_start(Value_Traits::to_value_ptr(a));
+        key_type a_end = Value_Traits::get_end(Value_Traits::to_value_ptr(a));
+        Other_Algorithms::for_each_intersection(b, a_start, a_end, [&] (other_const_node_ptr n) {
+            sink(a, n);
+            return true;
+        });
+        auto b_start = Other_Value_Traits::get_start(Other_Value_Traits::to_value_ptr(b));
+        auto b_end = Other_Value_Traits::get_end(Other_Value_Traits::to_value_ptr(b));
+        auto b_sink = [&] (const_node_ptr n) {
+            sink(n, b);
+            return true;
+        };
+        const_node_ptr a_l = Node_Traits::get_left(a);
+        const_node_ptr a_r = Node_Traits::get_right(a);
+        other_const_node_ptr b_l = Other_Node_Traits::get_left(b);
+        other_const_node_ptr b_r = Other_Node_Traits::get_right(b);
+        for_each_intersection(a_l, b_start, b_end, b_sink);
+        for_each_intersection(a_r, b_start, b_end, b_sink);
+        overlap_join< Other_Algorithms >(a_l, a_lo, b_l, b_lo, sink);
+        overlap_join< Other_Algorithms >(a_l, a_lo, b_r, b, sink);
+        overlap_join< Other_Algorithms >(a_r, a, b_l, b_lo, sink);
+        overlap_join< Other_Algorithms >(a_r, a, b_r, b, sink);
+    }
+
+    /** Find the first node with start >= key.
+     * @return The node, or header if there is none.
+     */
+    static node_ptr lower_bound_start(node_ptr header, const key_type& key)
+    {
+        node_ptr res = header;
+        node_ptr n = Node_Traits::get_parent(header);
+        while (n)
+        {
+            if (Value_Traits::get_start(Value_Traits::to_value_ptr(n)) < key)
+            {
+                n = Node_Traits::get_right(n);
+            }
+            else
+            {
+                res = n;
+                n = Node_Traits::get_left(n);
+            }
+        }
+        return res;
+    }
+
+    /** Find the first node, in tree order, with start > point.
+     * @return The node, or header if there is none.
+     */
+    static node_ptr next_after(node_ptr header, const key_type& point)
+    {
+        node_ptr res = header;
+        node_ptr n = Node_Traits::get_parent(header);
+        while (n)
+        {
+            if (point < Value_Traits::get_start(Value_Traits::to_value_ptr(n)))
+            {
+                res = n;
+                n = Node_Traits::get_left(n);
+            }
+            else
+            {
+                n = Node_Traits::get_right(n);
+            }
+        }
+        return res;
+    }
+
+    /** Find a node with the largest end among those with end < point.
+     * Subtrees with max_end < point are not entered, except for a final descent
+     * into the best one; the subtrees entered are those on the search path of
+     * the point, and those holding intervals that contain it. This takes
+     * O(log n + m), where m is the number of intervals containing the point.
+     * @return The node, or header if there is none.
+     */
+    static node_ptr prev_before(node_ptr header, const key_type& point)
+    {
+        node_ptr best_node = node_ptr();
+        node_ptr best_stree = node_ptr();
+        for_each_before(Node_Traits::get_parent(header), point,
+            [&] (node_ptr n) {
+                if (not best_stree or Node_Traits::get_max_end(best_stree) < Node_Traits::get_max_end(n))
+                {
+                    best_stree = n;
+                }
+            },
+            [&] (node_ptr n) {
+                if (not best_node or get_end(best_node) < get_end(n))
+                {
+                    best_node = n;
+                }
+            },
+            [] (node_ptr) { return true; });
+        if (best_stree and (not best_node or get_end(best_node) < Node_Traits::get_max_end(best_stree)))
+        {
+            best_node = max_end_node(best_stree);
+        }
+        return best_node ? best_node : header;
+    }
+
+    /** Find the k intervals closest to a point.
+     * The distance from the point to an interval is 0 if the interval contains
+     * it, and otherwise the distance to the nearest endpoint. Intervals
+     * containing the point are found as in prev_before(); intervals before it
+     * are then produced by decreasing end, with a heap of subtrees keyed by
+     * max_end, and intervals after it by increasing start, in tree order. The
+     * two sequences are merged. This takes O(log n + m + k log n) in the worst
+     * case, where m is the number of intervals containing the point: each
+     * interval before the point may take expanding O(log n) subtrees, and
+     * each interval after it a step in tree order.
+     * @param sink Callback invoked as sink(node) for at most k nodes, by
+     * increasing distance (in any order among equal distances).
+     */
+    template < typename Sink >
+    static void nearest(node_ptr header, const key_type& point, std::size_t k, Sink&& sink)
+    {
+        if (k == 0)
+        {
+            return;
+        }
+        // (key, node, whole subtree): key is end of node, or max_end of subtree
+        typedef std::tuple< key_type, node_ptr, bool > entry_type;
+        auto entry_less = [] (const entry_type& lhs, const entry_type& rhs) {
+            return std::get< 0 >(lhs) < std::get< 0 >(rhs);
+        };
+        std::priority_queue< entry_type, std::vector< entry_type >, decltype(entry_less) > before(entry_less);
+        std::size_t n_found = 0;
+        bool done = not for_each_before(Node_Traits::get_parent(header), point,
+            [&] (node_ptr n) { before.push(entry_type(Node_Traits::get_max_end(n), n, true)); },
+            [&] (node_ptr n) { before.push(entry_type(get_end(n), n, false)); },
+            [&] (node_ptr n) {
+                sink(n);
+                return ++n_found < k;
+            });
+        if (done)
+        {
+            return;
+        }
+        node_ptr after = next_after(header, point);
+        while (n_found < k)
+        {
+            // expand subtrees until the closest interval before the point is on top
+            while (not before.empty() and std::get< 2 >(before.top()))
+            {
+                node_ptr n = std::get< 1 >(before.top());
+                before.pop();
+                before.push(entry_type(get_end(n), n, false));
+                if (Node_Traits::get_left(n))
+                {
+                    before.push(entry_type(Node_Traits::get_max_end(Node_Traits::get_left(n)), Node_Traits::get_left(n), true));
+                }
+                if (Node_Traits::get_right(n))
+                {
+                    before.push(entry_type(Node_Traits::get_max_end(Node_Traits::get_right(n)), Node_Traits::get_right(n), true));
+                }
+            }
+            bool has_before = not before.empty();
+            bool has_after = after != header;
+            if (not has_before and not has_after)
+            {
+                return;
+            }
+            if (has_before
+                and (not has_after
+                     or not distance_less(point, Value_Traits::get_start(Value_Traits::to_value_ptr(after)),
+                                          std::get< 0 >(before.top()), point)))
+            {
+                sink(std::get< 1 >(before.top()));
+                before.pop();
+            }
+            else
+            {
+                sink(after);
+                after = itree_algorithms::next_node(after);
+            }
+            ++n_found;
+        }
+    }
+
+    /** Aggregate of a policy over the intervals with start in [lo, hi].
+     * Requires the policy among the itree_augment options. Descends to the
+     * node where the paths to lo and hi split, then combines the subtree
+     * aggregates hanging inside the range on each path, in O(log n).
+     * @return The aggregate, in tree order; identity() if the range is empty.
+     */
+    template < typename Policy >
+    static typename Policy::value_type aggregate_start_range(const_node_ptr n, const key_type& lo, const key_type& hi)
+    {
+        while (n)
+        {
+            key_type n_start = Value_Traits::get_start(Value_Traits::to_value_ptr(n));
+            if (n_start < lo)
+            {
+                n = Node_Traits::get_right(n);
+            }
+            else if (hi < n_start)
+            {
+                n = Node_Traits::get_left(n);
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (not n)
+        {
+            return Policy::identity();
+        }
+        typename Policy::value_type res = Node_Traits::template get_node_aggregate< Policy >(n);
+        // nodes of the left subtree with start >= lo, right to left
+        for (const_node_ptr l = Node_Traits::get_left(n); l; )
+        {
+            if (Value_Traits::get_start(Value_Traits::to_value_ptr(l)) < lo)
+            {
+                l = Node_Traits::get_right(l);
+                continue;
+            }
+            res = Policy::combine(combine_right< Policy >(Node_Traits::template get_node_aggregate< Policy >(l),
+                                                          Node_Traits::get_right(l)),
+                                  res);
+            l = Node_Traits::get_left(l);
+        }
+        // nodes of the right subtree with start <= hi, left to right
+        for (const_node_ptr r = Node_Traits::get_right(n); r; )
+        {
+            if (hi < Value_Traits::get_start(Value_Traits::to_value_ptr(r)))
+            {
+                r = Node_Traits::get_left(r);
+                continue;
+            }
+            res = Policy::combine(res, combine_left< Policy >(Node_Traits::get_left(r),
+                                                              Node_Traits::template get_node_aggregate< Policy >(r)));
+            r = Node_Traits::get_right(r);
+        }
+        return res;
+    }
+
+    /** Visit the nodes whose own aggregate satisfies a predicate.
+     * Subtrees whose aggregate fails the predicate are skipped: the predicate
+     * must fail on combine(a, b) only if it fails on both a and b, as for
+     * "max length >= L" with itree_max_length_augment.
+     * @param pred Callback invoked as pred(aggregate).
+     * @param visitor Callback invoked as visitor(node) in tree order;
+     * returning false stops the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < typename Policy, typename Predicate, typename Visitor >
+    static bool for_each_if(const_node_ptr n, Predicate&& pred, Visitor&& visitor)
+    {
+        if (not n or not pred(Node_Traits::template get_aggregate< Policy >(n)))
+        {
+            return true;
+        }
+        return (for_each_if< Policy >(Node_Traits::get_left(n), pred, visitor)
+                and (not pred(Node_Traits::template get_node_aggregate< Policy >(n)) or visitor(n))
+                and for_each_if< Policy >(Node_Traits::get_right(n), pred, visitor));
+    }
+
+    /** Recompute extra data on the path from a node up to the root. */
+    static void recompute_path(node_ptr header, node_ptr n)
+    {
+        for (; n != header; n = Node_Traits::get_parent(n))
+        {
+            Node_Traits::recompute_extra_data(n);
+        }
+    }
+
+    /** Recompute extra data on all nodes of a subtree, children first. */
+    static void recompute_subtree(node_ptr n)
+    {
+        if (n)
+        {
+            recompute_subtree(Node_Traits::get_left(n));
+            recompute_subtree(Node_Traits::get_right(n));
+            Node_Traits::recompute_extra_data(n);
+        }
+    }
+
+    /** Add delta to the stored max_end (and min_end) of all nodes in a subtree.
+     * For keys stored as absolute values; the node intervals are not read,
+     * so they may be shifted before or after.
+     * @param n Subtree root, possibly null.
+     * @param delta Value to add.
+     */
+    template < typename delta_type >
+    static void shift_subtree(node_ptr n, delta_type delta)
+    {
+        if (n)
+        {
+            shift_subtree(Node_Traits::get_left(n), delta);
+            shift_subtree(Node_Traits::get_right(n), delta);
+            Node_Traits::set_max_end(n, key_type(Node_Traits::get_max_end(n) + delta));
+            shift_min_end(n, delta, std::integral_constant< bool, Node_Traits::has_min_end >());
+        }
+    }
+
+    /** Recompute max_end from a node whose interval changed up to the root.
+     * Stops at the first node whose max_end is unchanged, since the max_end of
+     * its ancestors is then unchanged as well. Subtree counts are unaffected.
+     * When subtree min_end or other aggregates are maintained, the whole
+     * path is recomputed.
+     * @param header Tree header.
+     * @param n Node whose interval changed.
+     * @param old_max_end max_end of n before the change.
+     */
+    static void propagate_max_end(node_ptr header, node_ptr n, key_type old_max_end)
+    {
+        if (Node_Traits::has_min_end or Node_Traits::has_augment)
+        {
+            recompute_path(header, n);
+            return;
+        }
+        while (true)
+        {
+            Node_Traits::recompute_extra_data(n);
+            key_type new_max_end = Node_Traits::get_max_end(n);
+            n = Node_Traits::get_parent(n);
+            if (n == header or new_max_end == old_max_end)
+            {
+                return;
+            }
+            old_max_end = Node_Traits::get_max_end(n);
+        }
+    }
+
+    /** Number of black nodes on a path from a subtree root to a leaf. */
+    static std::size_t black_height(const_node_ptr n)
+    {
+        std::size_t res = 0;
+        for (; n; n = Node_Traits::get_left(n))
+        {
+            res += (is_red(n) ? 0 : 1);
+        }
+        return res;
+    }
+
+    /** Make a subtree the whole tree of a header.
+     * @param header Header; its previous contents are discarded.
+     * @param root Subtree root (may be null, or red).
+     */
+    static void set_root(node_ptr header, node_ptr root)
+    {
+        itree_algorithms::init_header(header);
+        if (root)
+        {
+            Node_Traits::set_parent(root, header);
+            Node_Traits::set_color(root, Node_Traits::black());
+            Node_Traits::set_parent(header, root);
+            Node_Traits::set_left(header, itree_algorithms::minimum(root));
+            Node_Traits::set_right(header, itree_algorithms::maximum(root));
+        }
+    }
+
+    /** Join two red-black subtrees with a middle node.
+     * All starts in l must be <= start of k, which must be <= all starts in
+     * r. Only the nodes on the right spine of the taller subtree (or the left
+     * spine of r) down to the black height of the other one are touched, so
+     * this takes O(|bh_l - bh_r| + 1). Extra data is recomputed on the way up.
+     * @param l Left subtree root (may be null, or red).
+     * @param bh_l Black height of l.
+     * @param k Middle node, unlinked.
+     * @param r Right subtree root (may be null, or red).
+     * @param bh_r Black height of r.
+     * @param bh Output: black height of the result.
+     * @return Root of the result; it may be red, and its parent is not set.
+     */
+    static node_ptr join3(node_ptr l, std::size_t bh_l, node_ptr k, node_ptr r, std::size_t bh_r,
+                          std::size_t& bh)
+    {
+        // the spine descent requires black roots
+        if (is_red(l))
+        {
+            Node_Traits::set_color(l, Node_Traits::black());
+            ++bh_l;
+        }
+        if (is_red(r))
+        {
+            Node_Traits::set_color(r, Node_Traits::black());
+            ++bh_r;
+        }
+        node_ptr t;
+        if (bh_r < bh_l)
+        {
+            t = join_right(l, bh_l, k, r, bh_r);
+            bh = bh_l;
+            if (is_red(t) and is_red(Node_Traits::get_right(t)))
+            {
+                Node_Traits::set_color(t, Node_Traits::black());
+                ++bh;
+            }
+        }
+        else if (bh_l < bh_r)
+        {
+            t = join_left(l, bh_l, k, r, bh_r);
+            bh = bh_r;
+            if (is_red(t) and is_red(Node_Traits::get_left(t)))
+            {
+                Node_Traits::set_color(t, Node_Traits::black());
+                ++bh;
+            }
+        }
+        else
+        {
+            t = make_node(l, k, r, Node_Traits::red());
+            bh = bh_l;
+        }
+        return t;
+    }
+
+    /** Split a red-black subtree by start, in O(log n).
+     * @param t Subtree root (may be null, or red).
+     * @param bh_t Black height of t.
+     * @param key Split key.
+     * @param l Output: root of the nodes with start < key.
+     * @param bh_l Output: black height of l.
+     * @param r Output: root of the nodes with start >= key.
+     * @param bh_r Output: black height of r.
+     */
+    static void split(node_ptr t, std::size_t bh_t, const key_type& key,
+                      node_ptr& l, std::size_t& bh_l, node_ptr& r, std::size_t& bh_r)
+    {
+        if (not t)
+        {
+            l = r = node_ptr();
+            bh_l = bh_r = 0;
+            return;
+        }
+        std::size_t bh_c = bh_t - (is_red(t) ? 0 : 1);
+        node_ptr t_l = Node_Traits::get_left(t);
+        node_ptr t_r = Node_Traits::get_right(t);
+        if (Value_Traits::get_start(Value_Traits::to_value_ptr(t)) < key)
+        {
+            node_ptr m;
+            std::size_t bh_m;
+            split(t_r, bh_c, key, m, bh_m, r, bh_r);
+            l = join3(t_l, bh_c, t, m, bh_m, bh_l);
+        }
+        else
+        {
+            node_ptr m;
+            std::size_t bh_m;
+            split(t_l, bh_c, key, l, bh_l, m, bh_m);
+            r = join3(m, bh_m, t, t_r, bh_c, bh_r);
+        }
+    }
+
+    /** Union of two red-black subtrees with arbitrary overlap.
+     * b is split by the root of a, and the halves are merged recursively with
+     * the subtrees of a, taking O(m log(n / m + 1)) for sizes m <= n.
+     * @param a First subtree root (may be null, or red).
+     * @param bh_a Black height of a.
+     * @param b Second subtree root (may be null, or red).
+     * @param bh_b Black height of b.
+     * @param bh Output: black height of the result.
+     * @return Root of the result; it may be red, and its parent is not set.
+     */
+    static node_ptr union_trees(node_ptr a, std::size_t bh_a, node_ptr b, std::size_t bh_b, std::size_t& bh)
+    {
+        if (not b)
+        {
+            bh = bh_a;
+            return a;
+        }
+        if (not a)
+        {
+            bh = bh_b;
+            return b;
+        }
+        std::size_t bh_c = bh_a - (is_red(a) ? 0 : 1);
+        node_ptr a_l = Node_Traits::get_left(a);
+        node_ptr a_r = Node_Traits::get_right(a);
+        node_ptr b_l;
+        node_ptr b_r;
+        std::size_t bh_b_l;
+        std::size_t bh_b_r;
+        split(b, bh_b, Value_Traits::get_start(Value_Traits::to_value_ptr(a)), b_l, bh_b_l, b_r, bh_b_r);
+        std::size_t bh_u_l;
+        std::size_t bh_u_r;
+        node_ptr u_l = union_trees(a_l, bh_c, b_l, bh_b_l, bh_u_l);
+        node_ptr u_r = union_trees(a_r, bh_c, b_r, bh_b_r, bh_u_r);
+        return join3(u_l, bh_u_l, a, u_r, bh_u_r, bh);
+    }
+
+    /** Link a sequence of nodes sorted by interval start into a balanced tree.
+     * The tree is built directly, in linear time, without rebalancing.
+     * The deepest level is coloured red if it is not full, every other level
+     * is black; max_end values are computed bottom-up.
+     * @param header Header of an empty tree.
+     * @param nodes Random access iterator to the first node.
+     * @param n_nodes Number of nodes.
+     */
+    template < typename Node_Iterator >
+    static void build_from_sorted(node_ptr header, Node_Iterator nodes, std::size_t n_nodes)
+    {
+        if (n_nodes == 0)
+        {
+            return;
+        }
+        // deepest level of a tree with n_nodes nodes; it is full iff n_nodes == 2^(d+1) - 1
+        std::size_t depth = 0;
+        while ((std::size_t(2) << depth) - 1 < n_nodes)
+        {
+            ++depth;
+        }
+        std::size_t red_depth = (depth > 0 and (std::size_t(2) << depth) - 1 != n_nodes ? depth : 0);
+        node_ptr root = build_subtree(nodes, 0, n_nodes, header, 0, red_depth);
+        Node_Traits::set_parent(header, root);
+        Node_Traits::set_left(header, nodes[0]);
+        Node_Traits::set_right(header, nodes[n_nodes - 1]);
+    }
+
+private:
+    static key_type get_end(const_node_ptr n)
+    {
+        return Value_Traits::get_end(Value_Traits::to_value_ptr(n));
+    }
+
+    /** Hint that a node and its value will be read soon. */
+    static void prefetch_node(const_node_ptr n)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(detail::to_raw_pointer(n));
+        __builtin_prefetch(detail::to_raw_pointer(Value_Traits::to_value_ptr(n)));
+#else
+        (void)n;
+#endif
+    }
+
+    static bool min_end_at_most(const_node_ptr n, const key_type& key, std::true_type)
+    {
+        return not (key < Node_Traits::get_min_end(n));
+    }
+    static bool min_end_at_most(const_node_ptr, const key_type&, std::false_type)
+    {
+        return true;
+    }
+
+    /** Compare the distances hi1 - lo1 < hi2 - lo2, for lo1 <= hi1 and lo2 <= hi2.
+     * Integral distances are computed in the unsigned type, where they cannot
+     * overflow, even between signed keys of opposite signs.
+     */
+    static bool distance_less(const key_type& lo1, const key_type& hi1, const key_type& lo2, const key_type& hi2)
+    {
+        return distance_less(lo1, hi1, lo2, hi2, std::is_integral< key_type >());
+    }
+    static bool distance_less(const key_type& lo1, const key_type& hi1, const key_type& lo2, const key_type& hi2,
+                              std::true_type)
+    {
+        typedef typename std::make_unsigned< key_type >::type unsigned_type;
+        return unsigned_type(unsigned_type(hi1) - unsigned_type(lo1))
+            < unsigned_type(unsigned_type(hi2) - unsigned_type(lo2));
+    }
+    static bool distance_less(const key_type& lo1, const key_type& hi1, const key_type& lo2, const key_type& hi2,
+                              std::false_type)
+    {
+        return hi1 - lo1 < hi2 - lo2;
+    }
+
+    template < typename delta_type >
+    static void shift_min_end(node_ptr n, delta_type delta, std::true_type)
+    {
+        Node_Traits::set_min_end(n, key_type(Node_Traits::get_min_end(n) + delta));
+    }
+    template < typename delta_type >
+    static void shift_min_end(node_ptr, delta_type, std::false_type)
+    {
+    }
+
+    /** combine(v, aggregate of subtree n), for a possibly null n. */
+    template < typename Policy >
+    static typename Policy::value_type combine_right(const typename Policy::value_type& v, const_node_ptr n)
+    {
+        return n ? Policy::combine(v, Node_Traits::template get_aggregate< Policy >(n)) : v;
+    }
+    /** combine(aggregate of subtree n, v), for a possibly null n. */
+    template < typename Policy >
+    static typename Policy::value_type combine_left(const_node_ptr n, const typename Policy::value_type& v)
+    {
+        return n ? Policy::combine(Node_Traits::template get_aggregate< Policy >(n), v) : v;
+    }
+
+    /** Visit a subtree around a point: whole subtrees with max_end < point,
+     * other nodes with end < point, and nodes containing the point.
+     * Subtrees of nodes starting after the point are skipped.
+     * @param stree_sink Callback invoked as stree_sink(node) on roots of whole
+     * subtrees with max_end < point; they are not entered.
+     * @param before_sink Callback invoked as before_sink(node) on other nodes
+     * with end < point.
+     * @param contain_sink Callback invoked as contain_sink(node) on nodes
+     * containing the point; returning false stops the traversal.
+     * @return False iff the traversal was stopped.
+     */
+    template < typename Stree_Sink, typename Before_Sink, typename Contain_Sink >
+    static bool for_each_before(node_ptr n, const key_type& point,
+                                Stree_Sink&& stree_sink, Before_Sink&& before_sink, Contain_Sink&& contain_sink)
+    {
+        if (not n)
+        {
+            return true;
+        }
+        if (Node_Traits::get_max_end(n) < point)
+        {
+            stree_sink(n);
+            return true;
+        }
+        if (not for_each_before(Node_Traits::get_left(n), point, stree_sink, before_sink, contain_sink))
+        {
+            return false;
+        }
+        if (point < Value_Traits::get_start(Value_Traits::to_value_ptr(n)))
+        {
+            // n and its right subtree start after the point
+            return true;
+        }
+        if (get_end(n) < point)
+        {
+            before_sink(n);
+        }
+        else if (not contain_sink(n))
+        {
+            return false;
+        }
+        return for_each_before(Node_Traits::get_right(n), point, stree_sink, before_sink, contain_sink);
+    }
+
+    /** Find a node whose end is the max_end of its subtree. */
+    static node_ptr max_end_node(node_ptr n)
+    {
+        key_type max_end = Node_Traits::get_max_end(n);
+        while (get_end(n) < max_end)
+        {
+            node_ptr l = Node_Traits::get_left(n);
+            n = (l and not (Node_Traits::get_max_end(l) < max_end) ? l : Node_Traits::get_right(n));
+        }
+        return n;
+    }
+
+    static bool is_red(const_node_ptr n)
+    {
+        return n and Node_Traits::get_color(n) == Node_Traits::red();
+    }
+
+    static node_ptr make_node(node_ptr l, node_ptr k, node_ptr r, typename Node_Traits::color c)
+    {
+        Node_Traits::set_left(k, l);
+        Node_Traits::set_right(k, r);
+        if (l)
+        {
+            Node_Traits::set_parent(l, k);
+        }
+        if (r)
+        {
+            Node_Traits::set_parent(r, k);
+        }
+        Node_Traits::set_color(k, c);
+        Node_Traits::recompute_extra_data(k);
+        return k;
+    }
+
+    // descend the right spine of l to a black node of black height bh_r
+    static node_ptr join_right(node_ptr l, std::size_t bh_l, node_ptr k, node_ptr r, std::size_t bh_r)
+    {
+        if (not is_red(l) and bh_l == bh_r)
+        {
+            return make_node(l, k, r, Node_Traits::red());
+        }
+        node_ptr c = join_right(Node_Traits::get_right(l), bh_l - (is_red(l) ? 0 : 1), k, r, bh_r);
+        Node_Traits::set_right(l, c);
+        Node_Traits::set_parent(c, l);
+        if (not is_red(l) and is_red(c) and is_red(Node_Traits::get_right(c)))
+        {
+            Node_Traits::set_color(Node_Traits::get_right(c), Node_Traits::black());
+            return rotate_subtree_left(l);
+        }
+        Node_Traits::recompute_extra_data(l);
+        return l;
+    }
+
+    // descend the left spine of r to a black node of black height bh_l
+    static node_ptr join_left(node_ptr l, std::size_t bh_l, node_ptr k, node_ptr r, std::size_t bh_r)
+    {
+        if (not is_red(r) and bh_l == bh_r)
+        {
+            return make_node(l, k, r, Node_Traits::red());
+        }
+        node_ptr c = join_left(l, bh_l, k, Node_Traits::get_left(r), bh_r - (is_red(r) ? 0 : 1));
+        Node_Traits::set_left(r, c);
+        Node_Traits::set_parent(c, r);
+        if (not is_red(r) and is_red(c) and is_red(Node_Traits::get_left(c)))
+        {
+            Node_Traits::set_color(Node_Traits::get_left(c), Node_Traits::black());
+            return rotate_subtree_right(r);
+        }
+        Node_Traits::recompute_extra_data(r);
+        return r;
+    }
+
+    // rotations of detached subtrees: the parent of the new root is not set
+    static node_ptr rotate_subtree_left(node_ptr n)
+    {
+        node_ptr x = Node_Traits::get_right(n);
+        node_ptr m = Node_Traits::get_left(x);
+        Node_Traits::set_right(n, m);
+        if (m)
+        {
+            Node_Traits::set_parent(m, n);
+        }
+        Node_Traits::set_left(x, n);
+        Node_Traits::set_parent(n, x);
+        Node_Traits::recompute_extra_data(n);
+        Node_Traits::recompute_extra_data(x);
+        return x;
+    }
+
+    static node_ptr rotate_subtree_right(node_ptr n)
+    {
+        node_ptr x = Node_Traits::get_left(n);
+        node_ptr m = Node_Traits::get_right(x);
+        Node_Traits::set_left(n, m);
+        if (m)
+        {
+            Node_Traits::set_parent(m, n);
+        }
+        Node_Traits::set_right(x, n);
+        Node_Traits::set_parent(n, x);
+        Node_Traits::recompute_extra_data(n);
+        Node_Traits::recompute_extra_data(x);
+        return x;
+    }
+
+    template < typename Node_Iterator >
+    static node_ptr build_subtree(Node_Iterator nodes, std::size_t lo, std::size_t hi,
+                                  node_ptr parent, std::size_t depth, std::size_t red_depth)
+    {
+        if (lo == hi)
+        {
+            return node_ptr();
         }
+        std::size_t mid = lo + (hi - lo) / 2;
+        node_ptr n = nodes[mid];
+        Node_Traits::set_parent(n, parent);
+        Node_Traits::set_left(n, build_subtree(nodes, lo, mid, n, depth + 1, red_depth));
+        Node_Traits::set_right(n, build_subtree(nodes, mid + 1, hi, n, depth + 1, red_depth));
+        Node_Traits::set_color(n, depth > 0 and depth == red_depth ? Node_Traits::red() : Node_Traits::black());
+        Node_Traits::recompute_extra_data(n);
+        return n;
     }
 };
 
@@ -0,0 +1,188 @@
+#ifndef __ITREE_AUGMENT_HPP
+#define __ITREE_AUGMENT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Aggregate policies for itree augmentation.
+ *
+ * Besides max_end, an itree can maintain any number of per-subtree
+ * aggregates, given as policies to the itree_augment option. A policy is a
+ * class providing:
+ *
+ *     typedef (implementation_defined) value_type;
+ *     static value_type identity();
+ *     static value_type combine(const value_type& lhs, const value_type& rhs);
+ *     static value_type from_value(const T& value, const key_type& start, const key_type& end);
+ *
+ * combine() must be associative, with identity() as neutral element. It is
+ * applied to subtrees in tree order (left subtree, node, right subtree), so
+ * it need not be commutative. The aggregate of a subtree must only depend on
+ * the values in it, not on the tree shape.
+ *
+ * The policies below are generic in the value type.
+ */
+
+/** Number of intervals. */
+struct itree_count_augment
+{
+    typedef std::size_t value_type;
+    static value_type identity() { return 0; }
+    static value_type combine(const value_type& lhs, const value_type& rhs) { return lhs + rhs; }
+    template < class T, class Key >
+    static value_type from_value(const T&, const Key&, const Key&) { return 1; }
+}; // struct itree_count_augment
+
+/** Minimum interval start.
+ * Depends on absolute positions: not preserved by implement_shift() and
+ * shift_from().
+ */
+template < class Key >
+struct itree_min_start_augment
+{
+    typedef Key value_type;
+    static value_type identity() { return std::numeric_limits< Key >::max(); }
+    static value_type combine(const value_type& lhs, const value_type& rhs) { return std::min(lhs, rhs); }
+    template < class T >
+    static value_type from_value(const T&, const Key& start, const Key&) { return start; }
+}; // struct itree_min_start_augment
+
+/** Maximum interval length (end - start). */
+template < class Key >
+struct itree_max_length_augment
+{
+    typedef Key value_type;
+    static value_type identity() { return Key(); }
+    static value_type combine(const value_type& lhs, const value_type& rhs) { return std::max(lhs, rhs); }
+    template < class T >
+    static value_type from_value(const T&, const Key& start, const Key& end) { return Key(end - start); }
+}; // struct itree_max_length_augment
+
+/** Total interval length (sum of end - start). */
+template < class Key >
+struct itree_total_length_augment
+{
+    typedef Key value_type;
+    static value_type identity() { return Key(); }
+    static value_type combine(const value_type& lhs, const value_type& rhs) { return lhs + rhs; }
+    template < class T >
+    static value_type from_value(const T&, const Key& start, const Key& end) { return Key(end - start); }
+}; // struct itree_total_length_augment
+
+/** Storage for the aggregates of a node, one per policy.
+ * Node Traits of an augmented itree hold it in every node, and provide:
+ *
+ *     static const itree_augment_data< Policies... >& get_augment(const_node_ptr);
+ *     static void set_augment(node_ptr, const itree_augment_data< Policies... >&);
+ */
+template < class ...Policies >
+using itree_augment_data = std::tuple< typename Policies::value_type... >;
+
+/** List of aggregate policies, as selected by the itree_augment option. */
+template < class ...Policies >
+struct itree_augment_list
+{
+    typedef std::tuple< Policies... > policies;
+    typedef itree_augment_data< Policies... > data_type;
+    static const std::size_t size = sizeof...(Policies);
+}; // struct itree_augment_list
+
+/** Option for make_itree/itree: aggregate policies maintained in every node.
+ * @see itree_count_augment
+ */
+template < class ...Policies >
+struct itree_augment
+{
+    template < class Base >
+    struct pack : Base
+    {
+        typedef itree_augment_list< Policies... > augment_type;
+    };
+}; // struct itree_augment
+
+namespace detail
+{
+
+/** Position of a policy in a list. */
+template < class Policy, class ...Policies >
+struct Augment_Index;
+
+template < class Policy, class ...Rest >
+struct Augment_Index< Policy, Policy, Rest... >
+    : std::integral_constant< std::size_t, 0 >
+{};
+
+template < class Policy, class First, class ...Rest >
+struct Augment_Index< Policy, First, Rest... >
+    : std::integral_constant< std::size_t, 1 + Augment_Index< Policy, Rest... >::value >
+{};
+
+template < class Policy, class List >
+struct Augment_Index_In;
+
+template < class Policy, class ...Policies >
+struct Augment_Index_In< Policy, itree_augment_list< Policies... > >
+    : Augment_Index< Policy, Policies... >
+{};
+
+/** Operations on the aggregates of all policies of a list.
+ * Every operation handles all policies in one pass, with the recursion on
+ * the policy index unrolled at compile time.
+ */
+template < class List, std::size_t I = 0, bool done = (I == List::size) >
+struct Augment_Ops
+{
+    typedef typename List::data_type data_type;
+    typedef typename std::tuple_element< I, typename List::policies >::type policy;
+    typedef Augment_Ops< List, I + 1 > next;
+
+    static void identity(data_type& d)
+    {
+        std::get< I >(d) = policy::identity();
+        next::identity(d);
+    }
+
+    /** Aggregate of a node from those of its children (either may be null). */
+    template < class T, class Key >
+    static void recompute(data_type& d, const data_type* left, const data_type* right,
+                          const T& value, const Key& start, const Key& end)
+    {
+        typename policy::value_type tmp = policy::from_value(value, start, end);
+        if (left)
+        {
+            tmp = policy::combine(std::get< I >(*left), tmp);
+        }
+        if (right)
+        {
+            tmp = policy::combine(tmp, std::get< I >(*right));
+        }
+        std::get< I >(d) = tmp;
+        next::recompute(d, left, right, value, start, end);
+    }
+}; // struct Augment_Ops
+
+template < class List, std::size_t I >
+struct Augment_Ops< List, I, true >
+{
+    typedef typename List::data_type data_type;
+
+    static void identity(data_type&) {}
+    template < class T, class Key >
+    static void recompute(data_type&, const data_type*, const data_type*, const T&, const Key&, const Key&) {}
+}; // struct Augment_Ops
+
+} // namespace detail
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef __ITREE_CURSOR_HPP
+#define __ITREE_CURSOR_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <vector>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Query cursor for intersection queries that advance along the key axis.
+ *
+ * The cursor keeps the path from the root to the node where its last query
+ * ended (the finger). The next query climbs this path only until the subtree
+ * holds every start <= int_end, except those to its left, and descends from
+ * there; the parts of the tree to the left of that subtree are visited only if
+ * the maximum end over them, kept along the path, reaches the query start.
+ * With queries sorted by start and short intervals, a query then costs about
+ * O(log d + k) instead of O(log n + k), where d is the number of intervals
+ * between the previous query end and the new one. Queries in any order give
+ * correct results, only slower.
+ *
+ * The cursor refers to the tree, which must outlive it; after the tree is
+ * modified, the cursor must be reset() before it is used again.
+ */
+template < class ITree >
+class itree_cursor
+{
+public:
+    typedef ITree itree_type;
+    typedef typename ITree::itree_algo itree_algo;
+    typedef typename ITree::Node_Traits Node_Traits;
+    typedef typename ITree::value_traits value_traits;
+    typedef typename ITree::value_type value_type;
+    typedef typename ITree::key_type key_type;
+    typedef typename ITree::const_pointer const_pointer;
+    typedef typename ITree::const_node_ptr const_node_ptr;
+
+    explicit itree_cursor(const ITree& t)
+        : _header(t.end().pointed_node())
+    {}
+
+    /** Forget the finger; the next query starts from the root. */
+    void reset() { _path.clear(); }
+
+    /** Visit intervals in the tree that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(value) in tree order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor)
+    {
+        const_node_ptr root = Node_Traits::get_parent(_header);
+        if (not root)
+        {
+            _path.clear();
+            return true;
+        }
+        if (_path.empty())
+        {
+            _path.push_back(Entry(root, const_node_ptr()));
+        }
+        // climb until the subtree holds every start <= int_end, except those on its left
+        while (_path.size() > 1 and _path.back().hi and not (int_end < get_start(_path.back().hi)))
+        {
+            _path.pop_back();
+        }
+        std::size_t level = _path.size() - 1;
+        const_node_ptr subtree = _path[level].node;
+        // ancestors whose node and left subtree may hold results, deepest first
+        const_node_ptr pieces[2 * CHAR_BIT * sizeof(std::size_t)];
+        std::size_t n_pieces = 0;
+        for (std::size_t j = level; j > 0 and _path[j].has_left and not (_path[j].left_max < int_start); --j)
+        {
+            const_node_ptr p = _path[j - 1].node;
+            if (Node_Traits::get_right(p) == _path[j].node and not (piece_max_end(p) < int_start))
+            {
+                pieces[n_pieces++] = p;
+            }
+        }
+        // move the finger to the last node with start <= int_end
+        for (const_node_ptr n = subtree; ; )
+        {
+            bool go_right = not (int_end < get_start(n));
+            const_node_ptr c = go_right ? Node_Traits::get_right(n) : Node_Traits::get_left(n);
+            if (not c)
+            {
+                break;
+            }
+            _path.push_back(go_right ? right_entry(_path.back(), c) : Entry(c, n, _path.back()));
+            n = c;
+        }
+        auto node_visitor = [&] (const_node_ptr n) { return visitor(*value_traits::to_value_ptr(n)); };
+        while (n_pieces > 0)
+        {
+            const_node_ptr p = pieces[--n_pieces];
+            if (not itree_algo::for_each_intersection(Node_Traits::get_left(p), int_start, int_end, node_visitor))
+            {
+                return false;
+            }
+            if (not (int_end < get_start(p)) and not (get_end(p) < int_start) and not node_visitor(p))
+            {
+                return false;
+            }
+        }
+        return itree_algo::for_each_intersection(subtree, int_start, int_end, node_visitor);
+    }
+
+    /** Return intervals in the tree that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param out Output iterator receiving pointers to values, in tree order.
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(const key_type& int_start, const key_type& int_end, Output_Iterator out)
+    {
+        for_each_intersection(int_start, int_end, [&] (const value_type& v) { *out++ = &v; return true; });
+        return out;
+    }
+
+private:
+    /** Node on the path from the root to the finger. */
+    struct Entry
+    {
+        /** Entry for the root. */
+        Entry(const_node_ptr _node, const_node_ptr _hi)
+            : node(_node), hi(_hi), left_max(), has_left(false) {}
+        /** Entry for a node, with the same intervals on its left as parent. */
+        Entry(const_node_ptr _node, const_node_ptr _hi, const Entry& parent)
+            : node(_node), hi(_hi), left_max(parent.left_max), has_left(parent.has_left) {}
+
+        const_node_ptr node;
+        // nearest ancestor with node in its left subtree: it bounds the starts of the subtree from above
+        const_node_ptr hi;
+        // maximum end of all intervals before the subtree, if has_left
+        key_type left_max;
+        bool has_left;
+    };
+
+    static Entry right_entry(const Entry& parent, const_node_ptr n)
+    {
+        Entry res(n, parent.hi, parent);
+        key_type m = piece_max_end(parent.node);
+        res.left_max = (res.has_left ? std::max(res.left_max, m) : m);
+        res.has_left = true;
+        return res;
+    }
+
+    /** Maximum end over a node and its left subtree. */
+    static key_type piece_max_end(const_node_ptr p)
+    {
+        key_type res = get_end(p);
+        if (Node_Traits::get_left(p))
+        {
+            res = std::max(res, Node_Traits::get_max_end(Node_Traits::get_left(p)));
+        }
+        return res;
+    }
+
+    static key_type get_start(const_node_ptr n) { return value_traits::get_start(value_traits::to_value_ptr(n)); }
+    static key_type get_end(const_node_ptr n) { return value_traits::get_end(value_traits::to_value_ptr(n)); }
+
+    const_node_ptr _header;
+    std::vector< Entry > _path;
+}; // class itree_cursor
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
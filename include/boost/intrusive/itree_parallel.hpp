@@ -0,0 +1,208 @@
+#ifndef __ITREE_PARALLEL_HPP
+#define __ITREE_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+template < class Index >
+class parallel_query_result;
+
+namespace detail
+{
+
+/** Joins a group of worker threads when it goes out of scope.
+ * Declared after the state shared with the workers, so that it joins them
+ * before that state is destroyed, also when starting a thread or the work
+ * done by the calling thread throws.
+ */
+class Thread_Group_Joiner
+{
+public:
+    explicit Thread_Group_Joiner(std::vector< std::thread >& threads) : _threads(threads) {}
+    Thread_Group_Joiner(const Thread_Group_Joiner&) = delete;
+    Thread_Group_Joiner& operator = (const Thread_Group_Joiner&) = delete;
+    ~Thread_Group_Joiner()
+    {
+        for (auto& t : _threads)
+        {
+            if (t.joinable())
+            {
+                t.join();
+            }
+        }
+    }
+
+private:
+    std::vector< std::thread >& _threads;
+}; // class Thread_Group_Joiner
+
+} // namespace detail
+
+template < class Index, class Query_Iterator >
+parallel_query_result< Index >
+parallel_iintersect(const Index& index, Query_Iterator b, Query_Iterator e,
+                    std::size_t n_threads = 0, std::size_t chunk_size = 0);
+
+/** Results of a parallel batch query, see parallel_iintersect().
+ *
+ * Hits are kept in the per-chunk buffers written by the worker threads.
+ * Chunks are contiguous ranges of query indexes, and hits within a chunk are
+ * in query order, then in start order; so visiting the chunks in order yields
+ * the same sequence regardless of the number of threads or their scheduling.
+ */
+template < class Index >
+class parallel_query_result
+{
+public:
+    typedef typename Index::value_type value_type;
+    typedef const value_type* const_pointer;
+    /** Query index and pointer to an intersecting element. */
+    typedef std::pair< std::size_t, const_pointer > hit_type;
+
+    /** Total number of hits. */
+    std::size_t size() const
+    {
+        std::size_t res = 0;
+        for (const auto& c : _chunks)
+        {
+            res += c.size();
+        }
+        return res;
+    }
+
+    /** Visit hits in query index order, as sink(query_index, value). */
+    template < class Sink >
+    void for_each(Sink&& sink) const
+    {
+        for (const auto& c : _chunks)
+        {
+            for (const auto& h : c)
+            {
+                sink(h.first, *h.second);
+            }
+        }
+    }
+
+    /** Merge hits into a single vector, in query index order. */
+    std::vector< hit_type > merged() const
+    {
+        std::vector< hit_type > res;
+        res.reserve(size());
+        for (const auto& c : _chunks)
+        {
+            res.insert(res.end(), c.begin(), c.end());
+        }
+        return res;
+    }
+
+    /** Merge hits into compressed form: the hits of query q are
+     * values[offsets[q]..offsets[q + 1]).
+     * @param n_queries Size of the query batch.
+     */
+    void merge_compressed(std::size_t n_queries,
+                          std::vector< std::size_t >& offsets, std::vector< const_pointer >& values) const
+    {
+        offsets.assign(n_queries + 1, 0);
+        values.clear();
+        values.reserve(size());
+        for (const auto& c : _chunks)
+        {
+            for (const auto& h : c)
+            {
+                ++offsets[h.first + 1];
+                values.push_back(h.second);
+            }
+        }
+        for (std::size_t q = 0; q < n_queries; ++q)
+        {
+            offsets[q + 1] += offsets[q];
+        }
+    }
+
+private:
+    template < class Index_, class Query_Iterator >
+    friend parallel_query_result< Index_ >
+    parallel_iintersect(const Index_&, Query_Iterator, Query_Iterator, std::size_t, std::size_t);
+
+    std::vector< std::vector< hit_type > > _chunks;
+}; // class parallel_query_result
+
+/** Compute intersections of a batch of queries on several threads.
+ * The queries are split into chunks of consecutive indexes, which the threads
+ * claim dynamically, so that uneven chunks do not stall the batch; every
+ * chunk is answered with for_each_intersection() and written to its own
+ * buffer. The index is only read, and must not be modified meanwhile.
+ * Works with itree, frozen_itree, btree_itree and sharded_itree.
+ * @param index Interval index.
+ * @param b Begin of random access range of (start, end) pairs.
+ * @param e End of random access range of (start, end) pairs.
+ * @param n_threads Number of threads; 0 means hardware concurrency.
+ * @param chunk_size Number of queries per chunk; 0 picks a size giving
+ * several chunks per thread.
+ */
+template < class Index, class Query_Iterator >
+parallel_query_result< Index >
+parallel_iintersect(const Index& index, Query_Iterator b, Query_Iterator e,
+                    std::size_t n_threads, std::size_t chunk_size)
+{
+    typedef parallel_query_result< Index > result_type;
+    typedef typename Index::value_type value_type;
+    std::size_t n_queries = std::size_t(std::distance(b, e));
+    if (n_threads == 0)
+    {
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (chunk_size == 0)
+    {
+        chunk_size = std::max(std::size_t(1), std::min(std::size_t(4096), n_queries / (8 * n_threads)));
+    }
+    result_type res;
+    std::size_t n_chunks = (n_queries + chunk_size - 1) / chunk_size;
+    res._chunks.resize(n_chunks);
+    n_threads = std::max(std::size_t(1), std::min(n_threads, n_chunks));
+    std::atomic< std::size_t > next_chunk(0);
+    auto worker = [&] ()
+    {
+        for (std::size_t c = next_chunk++; c < n_chunks; c = next_chunk++)
+        {
+            // fill a local buffer, to avoid false sharing on the chunk vectors
+            std::vector< typename result_type::hit_type > buf;
+            std::size_t q_end = std::min(n_queries, (c + 1) * chunk_size);
+            for (std::size_t q = c * chunk_size; q < q_end; ++q)
+            {
+                const auto& query = b[q];
+                index.for_each_intersection(query.first, query.second, [&] (const value_type& v) {
+                    buf.push_back(typename result_type::hit_type(q, &v));
+                    return true;
+                });
+            }
+            res._chunks[c] = std::move(buf);
+        }
+    };
+    std::vector< std::thread > threads;
+    {
+        detail::Thread_Group_Joiner joiner(threads);
+        for (std::size_t i = 1; i < n_threads; ++i)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+    }
+    return res;
+}
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
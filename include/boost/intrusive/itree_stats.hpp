@@ -0,0 +1,150 @@
+#ifndef __ITREE_STATS_HPP
+#define __ITREE_STATS_HPP
+
+#include <cstddef>
+#include <boost/intrusive/rbtree.hpp>
+#include "itree_augment.hpp"
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Query statistics policy that records nothing.
+ *
+ * This is the default policy: all hooks are empty and inlined away, and the
+ * policy takes no space in the tree or in its iterators.
+ *
+ * A stats policy is a default constructible class providing the hooks below,
+ * invoked by the query traversals of an itree.
+ */
+struct null_itree_stats
+{
+    /** A query is started. */
+    void begin_query() {}
+    /** The traversal entered a node. */
+    void visit() {}
+    /** The traversal skipped a subtree, by max_end or by start. */
+    void prune() {}
+    /** The traversal returned from a subtree to its parent. */
+    void climb() {}
+    /** A node was reported as a result. */
+    void report() {}
+}; // struct null_itree_stats
+
+/** Query statistics policy counting traversal events.
+ *
+ * Counters are kept for the last query and in aggregate over all queries
+ * since construction (or the last reset()). Updating them makes queries
+ * modify the tree object, so a tree using this policy must not be queried
+ * from several threads concurrently.
+ */
+struct itree_query_stats
+{
+    struct counters
+    {
+        counters() : n_queries(0), visited(0), pruned(0), climbed(0), reported(0) {}
+
+        std::size_t n_queries;
+        std::size_t visited;
+        std::size_t pruned;
+        std::size_t climbed;
+        std::size_t reported;
+    }; // struct counters
+
+    void begin_query()
+    {
+        last = counters();
+        last.n_queries = 1;
+        ++total.n_queries;
+    }
+    void visit() { ++last.visited; ++total.visited; }
+    void prune() { ++last.pruned; ++total.pruned; }
+    void climb() { ++last.climbed; ++total.climbed; }
+    void report() { ++last.reported; ++total.reported; }
+
+    void reset()
+    {
+        last = counters();
+        total = counters();
+    }
+
+    counters last;
+    counters total;
+}; // struct itree_query_stats
+
+/** Option for make_itree/itree: query statistics policy.
+ * @see null_itree_stats, itree_query_stats
+ */
+template < class Stats >
+struct itree_stats
+{
+    template < class Base >
+    struct pack : Base
+    {
+        typedef Stats stats_type;
+    };
+}; // struct itree_stats
+
+/** Default options for itree: those of rbtree, no query statistics, and
+ * no aggregates besides max_end.
+ */
+struct itree_defaults : rbtree_defaults
+{
+    typedef null_itree_stats stats_type;
+    typedef itree_augment_list<> augment_type;
+}; // struct itree_defaults
+
+namespace detail
+{
+
+/** Reference to a stats object, held by query policies and trees.
+ * Empty for null_itree_stats.
+ */
+template < class Stats >
+class Stats_Ref
+{
+public:
+    explicit Stats_Ref(Stats* stats = nullptr) : _stats(stats) {}
+    Stats& stats() const { return *_stats; }
+
+private:
+    Stats* _stats;
+}; // class Stats_Ref
+
+template <>
+class Stats_Ref< null_itree_stats >
+{
+public:
+    explicit Stats_Ref(null_itree_stats* = nullptr) {}
+    null_itree_stats& stats() const
+    {
+        static null_itree_stats s;
+        return s;
+    }
+}; // class Stats_Ref
+
+/** Stats object owned by a tree. Empty for null_itree_stats. */
+template < class Stats >
+class Stats_Holder
+{
+public:
+    Stats& stats() const { return _stats; }
+
+private:
+    mutable Stats _stats;
+}; // class Stats_Holder
+
+template <>
+class Stats_Holder< null_itree_stats >
+    : public Stats_Ref< null_itree_stats >
+{
+}; // class Stats_Holder
+
+} // namespace detail
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
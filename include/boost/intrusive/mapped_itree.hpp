@@ -0,0 +1,349 @@
+#ifndef __MAPPED_ITREE_HPP
+#define __MAPPED_ITREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "frozen_itree.hpp"
+
+
+namespace boost
+{
+namespace intrusive
+{
+namespace detail
+{
+
+/** Header of the on-disk interval index format.
+ *
+ * The header is followed by four arrays of size entries, each starting at an
+ * offset (from the beginning of the file) that is a multiple of 64: starts,
+ * ends and max_ends (key_type, forming an implicit interval tree, see
+ * implicit_itree_algorithms), and ids (std::uint64_t). Integers are stored
+ * in the byte order of the writer, which is recorded in byte_order.
+ */
+struct Mapped_ITree_Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t key_size;
+    std::uint64_t byte_order;
+    std::uint64_t size;
+    std::uint64_t starts_offset;
+    std::uint64_t ends_offset;
+    std::uint64_t max_ends_offset;
+    std::uint64_t ids_offset;
+    std::uint64_t file_size;
+
+    static const char* expected_magic() { return "ITREEMAP"; }
+    static std::uint32_t expected_version() { return 1; }
+    static std::uint64_t expected_byte_order() { return 0x0102030405060708ull; }
+    static std::uint64_t alignment() { return 64; }
+}; // struct Mapped_ITree_Header
+
+} // namespace detail
+
+/** Read-only interval index stored in a position-independent format.
+ *
+ * The index is a serialized frozen_itree (see save_mapped_itree()): arrays of
+ * starts, ends and precomputed max_ends forming an implicit interval tree,
+ * plus a 64-bit id per interval in place of the pointers to the original
+ * elements. Since there are no links, the data is queried in place, either
+ * from a buffer in memory or from a file mapped read-only with mmap(); in the
+ * latter case, all processes mapping the same file share one copy in the
+ * page cache. Opening only validates the header, in O(1); check() verifies
+ * the contents.
+ */
+template < typename Key_Type >
+class mapped_itree
+{
+public:
+    typedef Key_Type key_type;
+    typedef std::uint64_t id_type;
+    typedef std::size_t size_type;
+    typedef implicit_itree_algorithms< key_type > implicit_algo;
+    typedef detail::Mapped_ITree_Header header_type;
+
+    static_assert(std::is_trivially_copyable< key_type >::value, "mapped_itree key_type must be trivially copyable");
+
+    // disallow copy
+    mapped_itree(const mapped_itree&) = delete;
+    mapped_itree& operator = (const mapped_itree&) = delete;
+
+    /** View an index stored in memory.
+     * The buffer is not copied, and must outlive this object.
+     * @param data Buffer holding the index, aligned to at least alignof(key_type).
+     * @param data_size Buffer size in bytes.
+     * @throw std::runtime_error if the header is invalid.
+     */
+    mapped_itree(const void* data, std::size_t data_size)
+        : _data(static_cast< const char* >(data)), _data_size(data_size), _mapped(false)
+    {
+        init();
+    }
+
+    /** Map an index file read-only.
+     * @param path File name.
+     * @throw std::runtime_error if the file cannot be mapped, or the header is invalid.
+     */
+    explicit mapped_itree(const std::string& path)
+        : _data(nullptr), _data_size(0), _mapped(false)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("mapped_itree: cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 or st.st_size <= 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("mapped_itree: cannot stat " + path);
+        }
+        void* p = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            throw std::runtime_error("mapped_itree: cannot map " + path);
+        }
+        _data = static_cast< const char* >(p);
+        _data_size = std::size_t(st.st_size);
+        _mapped = true;
+        try
+        {
+            init();
+        }
+        catch (...)
+        {
+            unmap();
+            throw;
+        }
+    }
+
+    mapped_itree(mapped_itree&& other)
+        : _data(other._data), _data_size(other._data_size), _mapped(other._mapped),
+          _size(other._size), _starts(other._starts), _ends(other._ends),
+          _max_ends(other._max_ends), _ids(other._ids)
+    {
+        other._mapped = false;
+    }
+
+    ~mapped_itree() { unmap(); }
+
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /** Id of the interval at a given position (in start order). */
+    id_type id(size_type i) const { return _ids[i]; }
+    const key_type& start(size_type i) const { return _starts[i]; }
+    const key_type& end(size_type i) const { return _ends[i]; }
+
+    /** Get maximum right endpoint in the index. */
+    key_type max_end() const
+    {
+        return _size == 0 ? key_type() : _max_ends[_size / 2];
+    }
+
+    /** Visit intervals that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(position) in start order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        return implicit_algo::for_each_intersection(
+            _starts, _ends, _max_ends, _size, int_start, int_end, visitor);
+    }
+
+    /** Return ids of intervals that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param out Output iterator receiving ids, in start order.
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(const key_type& int_start, const key_type& int_end, Output_Iterator out) const
+    {
+        implicit_algo::for_each_intersection(
+            _starts, _ends, _max_ends, _size, int_start, int_end,
+            [&] (size_type i) { *out++ = _ids[i]; return true; });
+        return out;
+    }
+
+    /** Verify the contents: starts are sorted, and every max_end is correct.
+     * Takes linear time.
+     */
+    bool check() const
+    {
+        for (size_type i = 1; i < _size; ++i)
+        {
+            if (_starts[i] < _starts[i - 1])
+            {
+                return false;
+            }
+        }
+        std::vector< key_type > max_ends(_size);
+        if (_size > 0)
+        {
+            implicit_algo::build_max_ends(_ends, max_ends.data(), _size);
+        }
+        for (size_type i = 0; i < _size; ++i)
+        {
+            if (max_ends[i] < _max_ends[i] or _max_ends[i] < max_ends[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    void init()
+    {
+        header_type h;
+        if (_data_size < sizeof(h))
+        {
+            throw std::runtime_error("mapped_itree: truncated header");
+        }
+        std::memcpy(&h, _data, sizeof(h));
+        if (std::memcmp(h.magic, header_type::expected_magic(), sizeof(h.magic)) != 0)
+        {
+            throw std::runtime_error("mapped_itree: bad magic");
+        }
+        if (h.byte_order != header_type::expected_byte_order())
+        {
+            throw std::runtime_error("mapped_itree: byte order mismatch");
+        }
+        if (h.version != header_type::expected_version() or h.key_size != sizeof(key_type))
+        {
+            throw std::runtime_error("mapped_itree: version or key size mismatch");
+        }
+        if (h.file_size != _data_size
+            or not check_array(h.starts_offset, h.size, sizeof(key_type))
+            or not check_array(h.ends_offset, h.size, sizeof(key_type))
+            or not check_array(h.max_ends_offset, h.size, sizeof(key_type))
+            or not check_array(h.ids_offset, h.size, sizeof(id_type)))
+        {
+            throw std::runtime_error("mapped_itree: bad array bounds");
+        }
+        if (reinterpret_cast< std::uintptr_t >(_data) % alignof(key_type) != 0
+            or reinterpret_cast< std::uintptr_t >(_data) % alignof(id_type) != 0)
+        {
+            throw std::runtime_error("mapped_itree: misaligned buffer");
+        }
+        _size = size_type(h.size);
+        _starts = reinterpret_cast< const key_type* >(_data + h.starts_offset);
+        _ends = reinterpret_cast< const key_type* >(_data + h.ends_offset);
+        _max_ends = reinterpret_cast< const key_type* >(_data + h.max_ends_offset);
+        _ids = reinterpret_cast< const id_type* >(_data + h.ids_offset);
+    }
+
+    bool check_array(std::uint64_t offset, std::uint64_t n, std::size_t elem_size) const
+    {
+        return (offset % header_type::alignment() == 0
+                and offset <= _data_size
+                and n <= (_data_size - offset) / elem_size);
+    }
+
+    void unmap()
+    {
+        if (_mapped)
+        {
+            ::munmap(const_cast< char* >(_data), _data_size);
+            _mapped = false;
+        }
+    }
+
+    const char* _data;
+    std::size_t _data_size;
+    bool _mapped;
+    size_type _size;
+    const key_type* _starts;
+    const key_type* _ends;
+    const key_type* _max_ends;
+    const id_type* _ids;
+}; // class mapped_itree
+
+/** Write a frozen interval tree in the format read by mapped_itree.
+ * @param os Binary output stream.
+ * @param f Snapshot to write.
+ * @param id_of Callback invoked as id_of(value), returning the 64-bit id
+ * stored for every element, e.g. its position in an external table.
+ * @return The output stream.
+ */
+template < class Value_Traits, class Id_Of >
+std::ostream& save_mapped_itree(std::ostream& os, const frozen_itree< Value_Traits >& f, Id_Of id_of)
+{
+    typedef typename Value_Traits::key_type key_type;
+    typedef detail::Mapped_ITree_Header header_type;
+    static_assert(std::is_trivially_copyable< key_type >::value, "mapped_itree key_type must be trivially copyable");
+
+    std::size_t n = f.size();
+    auto aligned = [] (std::uint64_t offset) {
+        return (offset + header_type::alignment() - 1) / header_type::alignment() * header_type::alignment();
+    };
+    header_type h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, header_type::expected_magic(), sizeof(h.magic));
+    h.version = header_type::expected_version();
+    h.key_size = sizeof(key_type);
+    h.byte_order = header_type::expected_byte_order();
+    h.size = n;
+    h.starts_offset = aligned(sizeof(h));
+    h.ends_offset = aligned(h.starts_offset + n * sizeof(key_type));
+    h.max_ends_offset = aligned(h.ends_offset + n * sizeof(key_type));
+    h.ids_offset = aligned(h.max_ends_offset + n * sizeof(key_type));
+    h.file_size = h.ids_offset + n * sizeof(std::uint64_t);
+
+    std::vector< key_type > starts(n);
+    std::vector< key_type > ends(n);
+    std::vector< key_type > max_ends(n);
+    std::vector< std::uint64_t > ids(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        starts[i] = f.start(i);
+        ends[i] = f.end(i);
+        ids[i] = id_of(*f.value(i));
+    }
+    if (n > 0)
+    {
+        implicit_itree_algorithms< key_type >::build_max_ends(ends.data(), max_ends.data(), n);
+    }
+
+    std::uint64_t pos = 0;
+    auto write = [&] (std::uint64_t offset, const void* p, std::size_t bytes) {
+        static const char zeros[64] = {};
+        while (pos < offset)
+        {
+            std::size_t k = std::size_t(std::min< std::uint64_t >(offset - pos, sizeof(zeros)));
+            os.write(zeros, k);
+            pos += k;
+        }
+        os.write(static_cast< const char* >(p), bytes);
+        pos += bytes;
+    };
+    write(0, &h, sizeof(h));
+    write(h.starts_offset, starts.data(), n * sizeof(key_type));
+    write(h.ends_offset, ends.data(), n * sizeof(key_type));
+    write(h.max_ends_offset, max_ends.data(), n * sizeof(key_type));
+    write(h.ids_offset, ids.data(), n * sizeof(std::uint64_t));
+    return os;
+}
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
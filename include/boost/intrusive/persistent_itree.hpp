@@ -0,0 +1,417 @@
+#ifndef __PERSISTENT_ITREE_HPP
+#define __PERSISTENT_ITREE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <utility>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Interval index with O(1) snapshots, by path copying.
+ *
+ * An AVL tree keyed by interval start, where every node holds the maximum
+ * end in its subtree. Nodes are immutable and shared between versions:
+ * insert() and erase() copy the O(log n) nodes on the path from the root to
+ * the update, recomputing their max_end and rebalancing on the copies, and
+ * leave the previous version intact. Copying a persistent_itree (or calling
+ * snapshot()) takes O(1) and gives an independent version; nodes are
+ * reference counted, and freed with the last version using them.
+ *
+ * Like btree_itree, the index is not intrusive: it owns its nodes, and refers
+ * to the elements through the Value Traits, which must provide key_type,
+ * get_start() and get_end(), as for itree. The endpoints are copied into the
+ * nodes; the elements must outlive every version referring to them.
+ *
+ * Distinct versions can be used and destroyed by different threads
+ * concurrently; a single version must not be modified while it is read.
+ */
+template < typename Value_Traits >
+class persistent_itree
+{
+public:
+    typedef typename Value_Traits::value_type value_type;
+    typedef typename Value_Traits::key_type key_type;
+    typedef typename Value_Traits::const_pointer const_pointer;
+    typedef typename Value_Traits::const_reference const_reference;
+    typedef std::size_t size_type;
+
+    persistent_itree() : _root(nullptr), _size(0) {}
+
+    template < class Iterator >
+    persistent_itree(Iterator b, Iterator e) : persistent_itree()
+    {
+        for (; b != e; ++b)
+        {
+            insert(*b);
+        }
+    }
+
+    /** Copy a version, in O(1). */
+    persistent_itree(const persistent_itree& other) : _root(acquire(other._root)), _size(other._size) {}
+
+    persistent_itree(persistent_itree&& other) : _root(other._root), _size(other._size)
+    {
+        other._root = nullptr;
+        other._size = 0;
+    }
+
+    persistent_itree& operator = (persistent_itree other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~persistent_itree() { release(_root); }
+
+    void swap(persistent_itree& other)
+    {
+        std::swap(_root, other._root);
+        std::swap(_size, other._size);
+    }
+
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /** Get an immutable handle on the current version, in O(1). */
+    persistent_itree snapshot() const { return *this; }
+
+    /** Insert an element, after the elements with an equal start.
+     * Copies O(log n) nodes; other versions are not modified.
+     */
+    void insert(const_reference v)
+    {
+        const_pointer p = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(v));
+        Node* new_root = insert_rec(_root, Value_Traits::get_start(p), Value_Traits::get_end(p), p);
+        release(_root);
+        _root = new_root;
+        ++_size;
+    }
+
+    /** Erase an element, identified by its address.
+     * Copies O(log n) nodes, plus the subtrees searched among k elements with
+     * the same start; other versions are not modified.
+     * @return True iff the element was found.
+     */
+    bool erase(const_reference v)
+    {
+        const_pointer p = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(v));
+        bool found = false;
+        Node* new_root = erase_rec(_root, Value_Traits::get_start(p), p, found);
+        if (not found)
+        {
+            return false;
+        }
+        release(_root);
+        _root = new_root;
+        --_size;
+        return true;
+    }
+
+    /** Remove all elements from this version. */
+    void clear()
+    {
+        release(_root);
+        _root = nullptr;
+        _size = 0;
+    }
+
+    /** Get maximum right endpoint in the index. */
+    key_type max_end() const
+    {
+        return _root ? _root->max_end : key_type();
+    }
+
+    /** Visit intervals that intersect a given interval.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(value) in start order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        return for_each_rec(_root, int_start, int_end, visitor);
+    }
+
+    /** Return intervals that intersect a given interval.
+     * @param out Output iterator receiving element pointers, in start order.
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(const key_type& int_start, const key_type& int_end, Output_Iterator out) const
+    {
+        for_each_intersection(int_start, int_end, [&] (const value_type& v) {
+            *out++ = Value_Traits::to_value_ptr(Value_Traits::to_node_ptr(v));
+            return true;
+        });
+        return out;
+    }
+
+    /** Check the tree invariants: start order, max_end, AVL balance and size.
+     * Takes O(n).
+     */
+    bool check() const
+    {
+        const Node* prev = nullptr;
+        std::size_t n = 0;
+        return check_rec(_root, prev, n) and n == _size;
+    }
+
+private:
+    /** Tree node; immutable once built, except for its reference count. */
+    struct Node
+    {
+        const_pointer value;
+        key_type start;
+        key_type end;
+        key_type max_end;
+        const Node* left;
+        const Node* right;
+        int height;
+        mutable std::atomic< std::size_t > refs;
+    };
+
+    // Reference conventions: functions taking "const Node*" borrow it, and
+    // functions returning "Node*" give the caller one reference.
+
+    static Node* acquire(const Node* n)
+    {
+        if (n)
+        {
+            n->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        return const_cast< Node* >(n);
+    }
+
+    static void release(const Node* n)
+    {
+        if (n and n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            release(n->left);
+            release(n->right);
+            delete n;
+        }
+    }
+
+    static int height(const Node* n) { return n ? n->height : 0; }
+
+    /** Build a node from owned children and the interval of proto. */
+    static Node* make(const Node* l, const Node& proto, const Node* r)
+    {
+        return make(l, proto.start, proto.end, proto.value, r);
+    }
+    static Node* make(const Node* l, const key_type& start, const key_type& end, const_pointer p, const Node* r)
+    {
+        Node* n = new Node;
+        n->value = p;
+        n->start = start;
+        n->end = end;
+        n->max_end = end;
+        if (l)
+        {
+            n->max_end = std::max(n->max_end, l->max_end);
+        }
+        if (r)
+        {
+            n->max_end = std::max(n->max_end, r->max_end);
+        }
+        n->left = l;
+        n->right = r;
+        n->height = 1 + std::max(height(l), height(r));
+        n->refs.store(1, std::memory_order_relaxed);
+        return n;
+    }
+
+    /** Build a balanced node from owned children whose heights differ by at most 2. */
+    static Node* balance(const Node* l, const Node& proto, const Node* r)
+    {
+        int hl = height(l);
+        int hr = height(r);
+        Node* res;
+        if (hl > hr + 1)
+        {
+            if (height(l->left) >= height(l->right))
+            {
+                res = make(acquire(l->left), *l, make(acquire(l->right), proto, r));
+            }
+            else
+            {
+                const Node* lr = l->right;
+                res = make(make(acquire(l->left), *l, acquire(lr->left)), *lr,
+                           make(acquire(lr->right), proto, r));
+            }
+            release(l);
+        }
+        else if (hr > hl + 1)
+        {
+            if (height(r->right) >= height(r->left))
+            {
+                res = make(make(l, proto, acquire(r->left)), *r, acquire(r->right));
+            }
+            else
+            {
+                const Node* rl = r->left;
+                res = make(make(l, proto, acquire(rl->left)), *rl,
+                           make(acquire(rl->right), *r, acquire(r->right)));
+            }
+            release(r);
+        }
+        else
+        {
+            res = make(l, proto, r);
+        }
+        return res;
+    }
+
+    static Node* insert_rec(const Node* t, const key_type& start, const key_type& end, const_pointer p)
+    {
+        if (not t)
+        {
+            return make(nullptr, start, end, p, nullptr);
+        }
+        if (start < t->start)
+        {
+            return balance(insert_rec(t->left, start, end, p), *t, acquire(t->right));
+        }
+        return balance(acquire(t->left), *t, insert_rec(t->right, start, end, p));
+    }
+
+    /** Remove the first node of a subtree; its fields are copied to min. */
+    static Node* remove_min(const Node* t, Node& min)
+    {
+        if (not t->left)
+        {
+            min.value = t->value;
+            min.start = t->start;
+            min.end = t->end;
+            return acquire(t->right);
+        }
+        return balance(remove_min(t->left, min), *t, acquire(t->right));
+    }
+
+    /** Join owned subtrees whose heights differ by at most 1, all of l before r. */
+    static Node* merge(const Node* l, const Node* r)
+    {
+        if (not l)
+        {
+            return const_cast< Node* >(r);
+        }
+        if (not r)
+        {
+            return const_cast< Node* >(l);
+        }
+        Node min;
+        Node* r2 = remove_min(r, min);
+        release(r);
+        return balance(l, min, r2);
+    }
+
+    /** Erase p, with the given start, from a subtree.
+     * @return The new subtree if found, or null.
+     */
+    static Node* erase_rec(const Node* t, const key_type& start, const_pointer p, bool& found)
+    {
+        if (not t)
+        {
+            return nullptr;
+        }
+        if (start < t->start)
+        {
+            Node* l = erase_rec(t->left, start, p, found);
+            return found ? balance(l, *t, acquire(t->right)) : nullptr;
+        }
+        if (t->start < start)
+        {
+            Node* r = erase_rec(t->right, start, p, found);
+            return found ? balance(acquire(t->left), *t, r) : nullptr;
+        }
+        // equal starts may lie on both sides
+        if (t->value == p)
+        {
+            found = true;
+            return merge(acquire(t->left), acquire(t->right));
+        }
+        Node* l = erase_rec(t->left, start, p, found);
+        if (found)
+        {
+            return balance(l, *t, acquire(t->right));
+        }
+        Node* r = erase_rec(t->right, start, p, found);
+        return found ? balance(acquire(t->left), *t, r) : nullptr;
+    }
+
+    template < class Visitor >
+    static bool for_each_rec(const Node* t, const key_type& int_start, const key_type& int_end, Visitor& visitor)
+    {
+        if (not t or t->max_end < int_start)
+        {
+            return true;
+        }
+        if (not for_each_rec(t->left, int_start, int_end, visitor))
+        {
+            return false;
+        }
+        if (int_end < t->start)
+        {
+            // this and all remaining nodes start after the interval
+            return true;
+        }
+        if (not (t->end < int_start) and not visitor(*t->value))
+        {
+            return false;
+        }
+        return for_each_rec(t->right, int_start, int_end, visitor);
+    }
+
+    /** Check a subtree, given the last node before it in start order. */
+    static bool check_rec(const Node* t, const Node*& prev, std::size_t& n)
+    {
+        if (not t)
+        {
+            return true;
+        }
+        if (not check_rec(t->left, prev, n))
+        {
+            return false;
+        }
+        if ((prev and t->start < prev->start)
+            or t->start != Value_Traits::get_start(t->value) or t->end != Value_Traits::get_end(t->value))
+        {
+            return false;
+        }
+        prev = t;
+        ++n;
+        if (not check_rec(t->right, prev, n))
+        {
+            return false;
+        }
+        key_type max_end = t->end;
+        if (t->left)
+        {
+            max_end = std::max(max_end, t->left->max_end);
+        }
+        if (t->right)
+        {
+            max_end = std::max(max_end, t->right->max_end);
+        }
+        return (t->max_end == max_end
+                and t->height == 1 + std::max(height(t->left), height(t->right))
+                and std::abs(height(t->left) - height(t->right)) <= 1
+                and t->refs.load(std::memory_order_relaxed) > 0);
+    }
+
+    const Node* _root;
+    size_type _size;
+}; // class persistent_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
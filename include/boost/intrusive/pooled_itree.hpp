@@ -0,0 +1,214 @@
+#ifndef __POOLED_ITREE_HPP
+#define __POOLED_ITREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Interval tree owning its elements, allocated from a pool of slabs.
+ *
+ * Elements are constructed in place in large contiguous slabs, and slots of
+ * erased elements are reused by later insertions. clear() resets the pool
+ * without freeing the slabs; with normal_link hooks and trivially destructible
+ * values, it takes O(1). clone_from() copies the elements of another tree, in
+ * order, into a single slab and links them with bulk_load(), so that
+ * neighbours in the tree are neighbours in memory.
+ *
+ * The copy constructor of the values is used to clone them; it must not copy
+ * the tree hooks (with safe_link hooks, it must leave them unlinked).
+ */
+template < class ITree >
+class pooled_itree
+{
+public:
+    typedef ITree itree_type;
+    typedef typename ITree::value_type value_type;
+    typedef typename ITree::key_type key_type;
+    typedef typename ITree::size_type size_type;
+    typedef typename ITree::iterator iterator;
+    typedef typename ITree::const_iterator const_iterator;
+
+    // disallow copy
+    pooled_itree(const pooled_itree&) = delete;
+    pooled_itree& operator = (const pooled_itree&) = delete;
+
+    /** Constructor.
+     * @param min_slab_size Number of elements in the first slab; later slabs
+     * double the capacity.
+     */
+    explicit pooled_itree(std::size_t min_slab_size = 1024)
+        : _min_slab_size(std::max< std::size_t >(min_slab_size, 1)), _slab(0), _slab_used(0)
+    {}
+
+    pooled_itree(pooled_itree&& other) = default;
+
+    ~pooled_itree() { clear(); }
+
+    /** The underlying tree, for queries. */
+    const itree_type& tree() const { return _tree; }
+
+    size_type size() const { return _tree.size(); }
+    bool empty() const { return _tree.empty(); }
+    iterator begin() { return _tree.begin(); }
+    iterator end() { return _tree.end(); }
+    const_iterator begin() const { return _tree.begin(); }
+    const_iterator end() const { return _tree.end(); }
+
+    /** Construct an element in the pool, and insert it in the tree.
+     * @param args Arguments of the value constructor.
+     * @return Iterator to the new element.
+     */
+    template < class ...Args >
+    iterator emplace(Args&&... args)
+    {
+        value_type* p = new (allocate()) value_type(std::forward< Args >(args)...);
+        return _tree.insert(*p);
+    }
+
+    /** Erase an element from the tree, and return its slot to the pool.
+     * @return Iterator to the next element.
+     */
+    iterator erase(const_iterator it)
+    {
+        value_type* p = const_cast< value_type* >(&*it);
+        iterator res = _tree.erase(it);
+        p->~value_type();
+        _free.push_back(p);
+        return res;
+    }
+
+    /** Remove all elements, keeping the slabs for reuse. */
+    void clear()
+    {
+        if (std::is_trivially_destructible< value_type >::value)
+        {
+            _tree.clear();
+        }
+        else
+        {
+            _tree.clear_and_dispose([] (value_type* p) { p->~value_type(); });
+        }
+        _free.clear();
+        _slab = 0;
+        _slab_used = 0;
+    }
+
+    /** Replace the contents by copies of the elements of another tree.
+     * The copies are made in tree order into one slab, and linked in linear
+     * time. The other slabs of this tree are released.
+     * @param other Tree to copy, either a pooled_itree or an itree_type.
+     */
+    void clone_from(const itree_type& other)
+    {
+        if (&other == &_tree)
+        {
+            return;
+        }
+        clear();
+        if (other.empty())
+        {
+            return;
+        }
+        // keep the first slab if it is large enough, as fresh memory is slow to touch
+        if (_slabs.empty() or _slabs[0].capacity < other.size())
+        {
+            _slabs.clear();
+            add_slab(other.size());
+        }
+        _slabs.resize(1);
+        value_type* b = slab_begin(0);
+        value_type* e = b;
+        for (const auto& v : other)
+        {
+            new (e) value_type(v);
+            ++e;
+        }
+        _slab_used = std::size_t(e - b);
+        _tree.bulk_load(b, e);
+    }
+    void clone_from(const pooled_itree& other) { clone_from(other._tree); }
+
+    /** Forwarded queries of the underlying tree. */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        return _tree.for_each_intersection(int_start, int_end, std::forward< Visitor >(visitor));
+    }
+    typename ITree::intersection_const_iterator_range iintersect(const key_type& int_start, const key_type& int_end) const
+    {
+        return _tree.iintersect(int_start, int_end);
+    }
+    typename ITree::stab_const_iterator_range istab(const key_type& point) const
+    {
+        return _tree.istab(point);
+    }
+
+private:
+    typedef typename std::aligned_storage< sizeof(value_type), alignof(value_type) >::type storage_type;
+
+    struct Slab
+    {
+        std::unique_ptr< storage_type[] > data;
+        std::size_t capacity;
+    };
+
+    value_type* slab_begin(std::size_t i) { return reinterpret_cast< value_type* >(_slabs[i].data.get()); }
+
+    void add_slab(std::size_t capacity)
+    {
+        Slab s;
+        s.data.reset(new storage_type[capacity]);
+        s.capacity = capacity;
+        _slabs.push_back(std::move(s));
+    }
+
+    /** Get uninitialized storage for one element. */
+    void* allocate()
+    {
+        if (not _free.empty())
+        {
+            value_type* p = _free.back();
+            _free.pop_back();
+            return p;
+        }
+        while (_slab < _slabs.size() and _slab_used == _slabs[_slab].capacity)
+        {
+            ++_slab;
+            _slab_used = 0;
+        }
+        if (_slab == _slabs.size())
+        {
+            std::size_t capacity = _min_slab_size;
+            for (const auto& s : _slabs)
+            {
+                capacity = std::max(capacity, s.capacity * 2);
+            }
+            add_slab(capacity);
+            _slab_used = 0;
+        }
+        return slab_begin(_slab) + _slab_used++;
+    }
+
+    itree_type _tree;
+    std::vector< Slab > _slabs;
+    std::vector< value_type* > _free;
+    std::size_t _min_slab_size;
+    // slab being filled, and number of its slots handed out
+    std::size_t _slab;
+    std::size_t _slab_used;
+}; // class pooled_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef __SHARDED_ITREE_HPP
+#define __SHARDED_ITREE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include <boost/iterator/indirect_iterator.hpp>
+#include "itree_parallel.hpp"
+
+
+namespace boost
+{
+namespace intrusive
+{
+
+/** Interval tree partitioned by interval start into independent shards.
+ *
+ * Given sorted boundaries b_1 < ... < b_{N-1}, shard i holds the intervals
+ * with start in [b_i, b_{i+1}) (with b_0 = -inf, b_N = +inf), in its own itree
+ * guarded by its own reader-writer lock. Writers touching different shards
+ * proceed in parallel, queries take shared locks and run in parallel with
+ * each other, and insert_parallel() loads a batch using one thread per shard.
+ *
+ * An interval may end past the upper boundary of its shard. Queries handle
+ * this by considering every shard up to the one containing the query end.
+ * Each shard publishes its max_end in an atomic, which queries read before
+ * locking, so shards that are empty or end before the query start are
+ * skipped without being locked. Results are produced in start order, as for
+ * a single itree.
+ *
+ * The key_type must be trivially copyable, for std::atomic.
+ */
+template < class ITree >
+class sharded_itree
+{
+public:
+    typedef ITree shard_type;
+    typedef typename ITree::value_traits value_traits;
+    typedef typename ITree::key_type key_type;
+    typedef typename ITree::value_type value_type;
+    typedef typename ITree::const_pointer const_pointer;
+    typedef typename ITree::size_type size_type;
+
+    // disallow copy
+    sharded_itree(const sharded_itree&) = delete;
+    sharded_itree& operator = (const sharded_itree&) = delete;
+
+    /** Constructor.
+     * @param b Begin of sorted range of shard boundaries.
+     * @param e End of sorted range of shard boundaries.
+     * There are (e - b) + 1 shards.
+     */
+    template < class Iterator >
+    sharded_itree(Iterator b, Iterator e)
+        : _boundaries(b, e)
+    {
+        for (std::size_t i = 0; i <= _boundaries.size(); ++i)
+        {
+            _shards.emplace_back(new Shard());
+        }
+    }
+
+    std::size_t n_shards() const { return _shards.size(); }
+
+    /** Index of the shard holding intervals that start at a given key. */
+    std::size_t shard_of(const key_type& start) const
+    {
+        return std::size_t(std::upper_bound(_boundaries.begin(), _boundaries.end(), start) - _boundaries.begin());
+    }
+
+    /** Access a shard directly. No locking is done.
+     * After modifying a shard this way, call sync_shard() before querying.
+     */
+    shard_type& shard(std::size_t i) { return _shards[i]->tree; }
+    const shard_type& shard(std::size_t i) const { return _shards[i]->tree; }
+
+    /** Number of intervals in all shards. Not synchronized with writers. */
+    size_type size() const
+    {
+        size_type res = 0;
+        for (const auto& s : _shards)
+        {
+            res += s->tree.size();
+        }
+        return res;
+    }
+
+    /** Get maximum right endpoint in all shards. Thread-safe; does not lock. */
+    key_type max_end() const
+    {
+        key_type res = key_type();
+        bool found = false;
+        for (const auto& s : _shards)
+        {
+            if (s->non_empty.load(std::memory_order_acquire))
+            {
+                key_type e = s->max_end.load(std::memory_order_relaxed);
+                if (not found or res < e)
+                {
+                    res = e;
+                }
+                found = true;
+            }
+        }
+        return res;
+    }
+
+    /** Insert an interval in its shard. Thread-safe. */
+    void insert(value_type& v)
+    {
+        Shard& s = *_shards[shard_of(get_start(v))];
+        std::lock_guard< Mutex > lock(s.mutex);
+        s.tree.insert(v);
+        s.publish_max_end();
+    }
+
+    /** Erase an interval from its shard. Thread-safe.
+     * The interval start must not have changed since insertion.
+     */
+    void erase(value_type& v)
+    {
+        Shard& s = *_shards[shard_of(get_start(v))];
+        std::lock_guard< Mutex > lock(s.mutex);
+        s.tree.erase(s.tree.iterator_to(v));
+        s.publish_max_end();
+    }
+
+    /** Remove all intervals. Not thread-safe. */
+    void clear()
+    {
+        for (auto& s : _shards)
+        {
+            s->tree.clear();
+            s->publish_max_end();
+        }
+    }
+
+    /** Refresh the max_end of a shard modified through shard(). Thread-safe. */
+    void sync_shard(std::size_t i)
+    {
+        Shard& s = *_shards[i];
+        std::lock_guard< Mutex > lock(s.mutex);
+        s.publish_max_end();
+    }
+
+    /** Insert a range of intervals, loading shards in parallel.
+     * Intervals are routed to their shards, then each shard is bulk loaded by
+     * one of n_threads worker threads. Thread-safe with respect to other
+     * writers and readers, which are blocked only on the shard being loaded.
+     * @param b Begin of range of values.
+     * @param e End of range of values.
+     * @param n_threads Number of worker threads; 0 means hardware concurrency.
+     */
+    template < class Iterator >
+    void insert_parallel(Iterator b, Iterator e, std::size_t n_threads = 0)
+    {
+        std::vector< std::vector< value_type* > > routed(n_shards());
+        for (; b != e; ++b)
+        {
+            value_type& v = *b;
+            routed[shard_of(get_start(v))].push_back(&v);
+        }
+        if (n_threads == 0)
+        {
+            n_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        n_threads = std::min(n_threads, n_shards());
+        std::atomic< std::size_t > next_shard(0);
+        auto worker = [&] ()
+        {
+            for (std::size_t i = next_shard++; i < routed.size(); i = next_shard++)
+            {
+                if (routed[i].empty())
+                {
+                    continue;
+                }
+                Shard& s = *_shards[i];
+                std::lock_guard< Mutex > lock(s.mutex);
+                s.tree.bulk_load(boost::make_indirect_iterator(routed[i].begin()),
+                                 boost::make_indirect_iterator(routed[i].end()));
+                s.publish_max_end();
+            }
+        };
+        std::vector< std::thread > threads;
+        {
+            detail::Thread_Group_Joiner joiner(threads);
+            for (std::size_t i = 1; i < n_threads; ++i)
+            {
+                threads.emplace_back(worker);
+            }
+            worker();
+        }
+    }
+
+    /** Visit intervals that intersect a given interval. Thread-safe.
+     * Each shard that may hold an intersection is locked in shared mode while
+     * it is traversed; the others are skipped without locking. The visitor
+     * must not modify this container.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param visitor Callback invoked as visitor(value) in start order; it
+     * returns false to stop the traversal.
+     * @return False iff the traversal was stopped by the visitor.
+     */
+    template < class Visitor >
+    bool for_each_intersection(const key_type& int_start, const key_type& int_end, Visitor&& visitor) const
+    {
+        if (int_end < int_start)
+        {
+            return true;
+        }
+        std::size_t last = shard_of(int_end);
+        for (std::size_t i = 0; i <= last; ++i)
+        {
+            const Shard& s = *_shards[i];
+            if (not s.may_intersect(int_start))
+            {
+                continue;
+            }
+            std::shared_lock< Mutex > lock(s.mutex);
+            if (s.tree.empty() or s.tree.max_end() < int_start)
+            {
+                continue;
+            }
+            if (not s.tree.for_each_intersection(int_start, int_end, visitor))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Return intervals that intersect a given interval. Thread-safe.
+     * @param int_start Interval start.
+     * @param int_end Interval end.
+     * @param out Output iterator receiving const_pointer values, in start order.
+     * @return The output iterator past the last element written.
+     */
+    template < class Output_Iterator >
+    Output_Iterator iintersect(const key_type& int_start, const key_type& int_end, Output_Iterator out) const
+    {
+        for_each_intersection(int_start, int_end, [&] (const value_type& v) {
+            *out++ = value_traits::to_value_ptr(value_traits::to_node_ptr(v));
+            return true;
+        });
+        return out;
+    }
+
+private:
+    typedef std::shared_timed_mutex Mutex;
+
+    struct Shard
+    {
+        Shard() : non_empty(false), max_end(key_type()) {}
+
+        /** Publish the max_end of the tree; called with the exclusive lock held. */
+        void publish_max_end()
+        {
+            if (not tree.empty())
+            {
+                max_end.store(tree.max_end(), std::memory_order_relaxed);
+            }
+            non_empty.store(not tree.empty(), std::memory_order_release);
+        }
+
+        /** Check the published max_end, without locking.
+         * A stale value only makes the query linearize before or after a
+         * concurrent writer; the tree is checked again under the lock.
+         */
+        bool may_intersect(const key_type& int_start) const
+        {
+            return (non_empty.load(std::memory_order_acquire)
+                    and not (max_end.load(std::memory_order_relaxed) < int_start));
+        }
+
+        shard_type tree;
+        mutable Mutex mutex;
+        std::atomic< bool > non_empty;
+        std::atomic< key_type > max_end;
+    };
+
+    static key_type get_start(const value_type& v)
+    {
+        return value_traits::get_start(value_traits::to_value_ptr(value_traits::to_node_ptr(v)));
+    }
+
+    std::vector< key_type > _boundaries;
+    std::vector< std::unique_ptr< Shard > > _shards;
+}; // class sharded_itree
+
+} // namespace intrusive
+} // namespace boost
+
+#endif